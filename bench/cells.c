@@ -0,0 +1,79 @@
+/*
+ * @file: bench/cells.c
+ * @brief: Time of sum, count and set over the whole table on 1 to 8 threads,
+ *         results of all thread counts must be the same
+ *
+ * usage: ./bench_cells [ROWS] [COLS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Table with pseudo-random decimal numbers and a few words in cells */
+void build(Table *table, int rows, int cols){
+    char buf[32];
+    unsigned seed = 1;
+    table_init(table);
+    table_reserve(table, rows);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        Row *row = &table->rows[i];
+        row_reserve(&table->arena, row, cols);
+        for (int j = 0; j < cols; j++){
+            seed = seed * 1103515245 + 12345;
+            int len = seed % 17 ? sprintf(buf, "%d.%03u", (int)(seed >> 12) % 20000 - 10000, seed % 1000)
+                                : sprintf(buf, "word");
+            row_append(&table->arena, row);
+            for (int k = 0; k < len; k++){
+                cell_append(&table->arena, &row->cells[j], buf[k]);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 4;
+    double first_sum = 0;
+    int first_count = 0;
+
+    printf("%d rows, %d cols\n", rows, cols);
+    printf("%8s %12s %12s %12s\n", "threads", "sum [s]", "count [s]", "set [s]");
+    for (int threads = 1; threads <= 8; threads *= 2){
+        Table table;
+        build(&table, rows, cols);
+        table.threads = threads;
+        Selection sc = {1, rows, 1, cols};
+        double sum, unused;
+        int count, nonempty;
+
+        double t0 = now();
+        cells_reduce(&sc, &table, OP_SUM, &sum, &count);
+        double t1 = now();
+        cells_reduce(&sc, &table, OP_COUNT, &unused, &nonempty);
+        double t2 = now();
+        table_fill(&sc, &table, "filled", " ");
+        double t3 = now();
+
+        if (threads == 1){
+            first_sum = sum;
+            first_count = count;
+        }
+        bool ok = sum == first_sum && count == first_count && nonempty == rows * cols;
+        for (int i = 0; ok && i < rows; i++){
+            Cell *cell = &table.rows[i].cells[cols-1];
+            ok = cell->size == 6 && !memcmp(cell->text, "filled", 6);
+        }
+        if (!ok){
+            fprintf(stderr, "%d threads: results differ from 1 thread\n", threads);
+            return 1;
+        }
+        printf("%8d %12.3f %12.3f %12.3f\n", threads, t1 - t0, t2 - t1, t3 - t2);
+        table_destroy(&table);
+    }
+    printf("sum %.17g of %d numbers\n", first_sum, first_count);
+    return 0;
+}
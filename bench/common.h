@@ -0,0 +1,67 @@
+/*
+ * @file: bench/common.h
+ * @brief: Helpers shared by benchmarks, included after ../sps.c
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <time.h>
+
+double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write a synthetic table with numbers, words, quoted cells and escapes delimited by ':'
+ * @param words: one of words cells is a word on average, the rest are numbers
+ */
+void generate_file(FILE *f, int rows, int cols, int words){
+    const char *texts[] = {"alpha", "beta", "\"quoted:cell\"", "esc\\:aped", "", "gamma"};
+    srand(1);
+    for (int i = 0; i < rows; i++){
+        for (int j = 0; j < cols; j++){
+            if (rand() % words){
+                fprintf(f, "%d.%d", rand() % 100000, rand() % 100);
+            } else {
+                fputs(texts[rand() % 6], f);
+            }
+            fputc(j == cols-1 ? '\n' : ':', f);
+        }
+    }
+}
+
+/* Compare two loaded tables cell by cell
+ * @return: true if tables are equal
+ */
+bool tables_equal(Table *a, Table *b){
+    if (a->size != b->size)
+        return false;
+    for (int i = 0; i < a->size; i++){
+        if (a->rows[i].size != b->rows[i].size)
+            return false;
+        for (int j = 0; j < a->rows[i].size; j++){
+            Cell *x = &a->rows[i].cells[j], *y = &b->rows[i].cells[j];
+            if (x->size != y->size || x->delim != y->delim || (x->size && memcmp(x->text, y->text, x->size)))
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Compare content of two files from their start
+ * @return: true if files are equal
+ */
+bool files_equal(FILE *a, FILE *b){
+    rewind(a);
+    rewind(b);
+    int c;
+    while ((c = fgetc(a)) == fgetc(b)){
+        if (c == EOF)
+            return true;
+    }
+    return false;
+}
+
+#endif
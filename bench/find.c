@@ -0,0 +1,148 @@
+/*
+ * @file: bench/find.c
+ * @brief: Time of repeated [find] over the whole table by scanning the cells
+ *         and through the hash index (-f), including the first lookup, which
+ *         builds the index, and time of [contains], [prefix] and [regex] scans
+ *         over cells and over columnar store (-c), rounds of [find], set and drow
+ *         check, that updates of the index stay cheaper than scans
+ *
+ * usage: ./bench_find [ROWS] [COLS] [FINDS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Table with pseudo-random numbers in cells, every value is there a few times */
+void build(Table *table, int rows, int cols){
+    char buf[16];
+    unsigned seed = 1;
+    table_init(table);
+    table_reserve(table, rows);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        Row *row = &table->rows[i];
+        row_reserve(&table->arena, row, cols);
+        for (int j = 0; j < cols; j++){
+            seed = seed * 1103515245 + 12345;
+            int len = sprintf(buf, "%u", (seed >> 8) % (unsigned)rows);
+            row_append(&table->arena, row);
+            for (int k = 0; k < len; k++){
+                cell_append(&table->arena, &row->cells[j], buf[k]);
+            }
+        }
+    }
+}
+
+/* Run all finds over the whole table
+ * @param found: positions of found cells, row*cols+col or -1
+ * @return: time in seconds
+ */
+double run(Table *table, Opcode op, char **strings, int finds, long *found){
+    double t0 = now();
+    for (int k = 0; k < finds; k++){
+        Selection sc = {1, table->size, 1, table->rows[0].size};
+        find_selection(&sc, table, op, strings[k]);
+        bool hit = sc.start_row == sc.end_row && sc.start_col == sc.end_col;
+        found[k] = hit ? (long)(sc.start_row-1) * table->rows[0].size + sc.start_col-1 : -1;
+    }
+    return now() - t0;
+}
+
+/* Rounds of [find], set of the found cell, set of all cells of the next row and drow 
+ * of the found row, the index is updated by the commands
+ * @param found: positions of found cells, row*cols+col or -1
+ * @return: time in seconds
+ */
+double rounds(Table *table, char **strings, int finds, long *found){
+    char text[] = "x", delims[] = ":";
+    double t0 = now();
+    for (int k = 0; k < finds; k++){
+        Selection sc = {1, table->size, 1, table->rows[0].size};
+        find_selection(&sc, table, OP_FIND, strings[k]);
+        bool hit = sc.start_row == sc.end_row && sc.start_col == sc.end_col;
+        found[k] = hit ? (long)(sc.start_row-1) * table->rows[0].size + sc.start_col-1 : -1;
+        if (!hit || sc.start_row == table->size){
+            continue;
+        }
+        table_fill(&sc, table, text, delims);
+        Selection next = {sc.start_row+1, sc.start_row+1, 1, table->rows[0].size};
+        table_fill(&next, table, text, delims);
+        edit_tstruc(&sc, OP_DROW, table, delims);
+    }
+    return now() - t0;
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 4;
+    int finds = argc > 3 ? atoi(argv[3]) : 40;
+
+    Table table;
+    build(&table, rows, cols);
+    char *strings[finds];
+    long found[2][finds];
+    for (int k = 0; k < finds; k++){
+        strings[k] = malloc(16);
+        sprintf(strings[k], "%d", k * (rows / finds) + (k % 2 ? rows : 0)); //odd ones are missing
+    }
+
+    double t_scan = run(&table, OP_FIND, strings, finds, found[0]);
+    table.index.enabled = true;
+    double t_first = now();
+    Selection sc = {1, table.size, 1, cols};
+    find_selection(&sc, &table, OP_FIND, strings[0]);
+    t_first = now() - t_first;
+    double t_index = run(&table, OP_FIND, strings, finds, found[1]);
+
+    if (memcmp(found[0], found[1], sizeof(found[0]))){
+        fprintf(stderr, "find: index and scan found different cells\n");
+        return 1;
+    }
+    printf("%d rows, %d cols, %d finds\n", rows, cols, finds);
+    printf("%-22s %10.3f s\n", "scan", t_scan);
+    printf("%-22s %10.3f s\n", "build index + 1 find", t_first);
+    printf("%-22s %10.6f s\n", "index", t_index);
+
+    //patterns, which are found late or not at all, so whole table is scanned
+    char *patterns[] = {"x", "99999999", "123456", "^9+$"};
+    const Opcode ops[] = {OP_CONTAINS, OP_PREFIX, OP_CONTAINS, OP_REGEX};
+    const char *names[] = {"contains (missing)", "prefix (missing)", "contains", "regex"};
+    for (int k = 0; k < 4; k++){
+        long found_cells, found_cols;
+        table.columns.enabled = false;
+        double t_cells = run(&table, ops[k], &patterns[k], 1, &found_cells);
+        table.columns.enabled = true;
+        run(&table, ops[k], &patterns[k], 1, &found_cols); //builds the columns
+        double t_cols = run(&table, ops[k], &patterns[k], 1, &found_cols);
+        if (found_cells != found_cols){
+            fprintf(stderr, "%s: cells and columns found different cells\n", names[k]);
+            return 1;
+        }
+        printf("%-22s %10.3f s (cells) %10.3f s (-c)\n", names[k], t_cells, t_cols);
+    }
+
+    table_destroy(&table);
+    build(&table, rows, cols);
+    for (int k = 0; k < finds; k++){
+        sprintf(strings[k], "%d", k); //small numbers are in many rows
+    }
+    double t_rounds_scan = rounds(&table, strings, finds, found[0]);
+    table_destroy(&table);
+    build(&table, rows, cols);
+    table.index.enabled = true;
+    double t_rounds_index = rounds(&table, strings, finds, found[1]);
+    if (memcmp(found[0], found[1], sizeof(found[0]))){
+        fprintf(stderr, "find, set, drow: index and scan found different cells\n");
+        return 1;
+    }
+    printf("%-22s %10.3f s (scan) %10.3f s (-f)\n", "find, set, drow", t_rounds_scan, t_rounds_index);
+
+    for (int k = 0; k < finds; k++){
+        free(strings[k]);
+    }
+    table_destroy(&table);
+    return 0;
+}
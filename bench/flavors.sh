@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# @file: bench/flavors.sh
+# @brief: Throughput of every build flavor (make release, make sps_asan) on the standard
+#         benchmark tables, printed as a markdown table in MB of input per second
+#         (best of REPEATS runs), flavors which are not built are skipped
+#
+# usage: bench/flavors.sh [ROWS] [REPEATS]
+#
+
+set -e
+rows=${1:-200000}
+repeats=${2:-3}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+./bench_suite -r "$rows" -c 6 -g "$dir/mixed.txt"
+./bench_suite -r "$rows" -c 4 -n 0.9 -q 0 -e 0 -g "$dir/numeric.txt"
+
+# name|table|commands
+cat > "$dir/workloads" <<'EOF'
+load+print|mixed|[1,1]
+search|mixed|[_,_];[contains zzz];[_,_];[regex ^a+b$]
+sort|numeric|[_,1];sort num
+group|mixed|[_,1];group sum 2
+sum|numeric|[_,1];sum [1,2];[_,2];avg [1,3]
+set|mixed|[_,2];set x;[_,3];clear
+structure|mixed|[_,2];icol;[_,3];dcol;[2,1,1000,1];drow
+EOF
+
+# wall time of one run in seconds
+run_time() {
+    start=$(date +%s%N)
+    "$@" < /dev/null > /dev/null
+    end=$(date +%s%N)
+    echo "$start $end" | awk '{printf "%.6f", ($2 - $1) / 1e9}'
+}
+
+printf "| %-10s |" "flavor"
+while IFS='|' read -r name table cmds; do
+    printf " %12s |" "$name"
+done < "$dir/workloads"
+printf "\n|------------|"
+while IFS='|' read -r name table cmds; do
+    printf -- "--------------|"
+done < "$dir/workloads"
+printf "\n"
+
+for flavor in sps_asan sps sps_o3 sps_native sps_lto sps_pgo; do
+    [ -x "./$flavor" ] || continue
+    printf "| %-10s |" "$flavor"
+    while IFS='|' read -r name table cmds; do
+        file="$dir/$table.txt"
+        mb=$(wc -c < "$file" | awk '{print $1 / 1e6}')
+        best=""
+        i=0
+        while [ $i -lt "$repeats" ]; do
+            t=$(run_time "./$flavor" -d : "$cmds" "$file")
+            best=$(echo "$t ${best:-$t}" | awk '{print ($1 < $2) ? $1 : $2}')
+            i=$((i + 1))
+        done
+        printf " %12s |" "$(echo "$mb $best" | awk '{printf "%.1f", $1 / $2}')"
+    done < "$dir/workloads"
+    printf "\n"
+done
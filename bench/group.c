@@ -0,0 +1,70 @@
+/*
+ * @file: bench/group.c
+ * @brief: Throughput of group command for growing number of distinct keys,
+ *         rows per second stay high while the groups fit in cache and fall
+ *         to memory latency of hash table probes with high-cardinality keys
+ *
+ * usage: ./bench_group [ROWS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Table with keys from [0,keys) in the first column and small integers in the second
+ * @return: sum of all values
+ */
+double build(Table *table, int rows, int keys){
+    char buf[16];
+    unsigned seed = 1;
+    double sum = 0;
+    table_init(table);
+    table_reserve(table, rows);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        Row *row = &table->rows[i];
+        row_reserve(&table->arena, row, 2);
+        seed = seed * 1103515245 + 12345;
+        int val = (seed >> 16) % 100;
+        sum += val;
+        for (int j = 0; j < 2; j++){
+            int len = sprintf(buf, "%u", j ? (unsigned)val : (seed >> 4) % (unsigned)keys);
+            row_append(&table->arena, row);
+            for (int k = 0; k < len; k++){
+                cell_append(&table->arena, &row->cells[j], buf[k]);
+            }
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 4000000;
+
+    printf("%10s %10s %10s %12s\n", "rows", "keys", "groups", "Mrows/s");
+    for (int keys = 16; keys <= rows; keys *= 16){
+        Table table;
+        double sum = build(&table, rows, keys);
+        Selection sc = {1, rows, 1, 1};
+        Instr ins = {OP_GROUP, {OP_SUM, 2, 0, 0}, -1};
+        double t0 = now();
+        if (group_selection(&sc, &table, &ins, " ")){
+            fprintf(stderr, "group: nedostatok pamate\n");
+            return 1;
+        }
+        double t = now() - t0;
+        double total = 0;
+        for (int i = rows; i < table.size; i++){
+            total += atof(table.rows[i].cells[1].text);
+        }
+        if (fabs(total - sum) > 1e-5 * sum){ //results are printed with %g
+            fprintf(stderr, "group: sums of groups do not add up\n");
+            return 1;
+        }
+        printf("%10d %10d %10d %12.1f\n", rows, keys, table.size - rows, rows / t / 1e6);
+        table_destroy(&table);
+    }
+    return 0;
+}
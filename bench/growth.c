@@ -0,0 +1,52 @@
+/*
+ * @file: bench/growth.c
+ * @brief: Time of appending rows and cells to a table for growing row counts,
+ *         time per row stays the same when growth is amortized O(1)
+ *
+ * usage: ./bench_growth [MAX_ROWS] [COLS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Append rows one by one the same way create_table does
+ * @param presize: reserve rows and cells before appending
+ * @return: time in seconds
+ */
+double fill(int rows, int cols, bool presize){
+    Table table;
+    table_init(&table);
+    double t0 = now();
+    if (presize){
+        table_reserve(&table, rows);
+    }
+    for (int i = 0; i < rows; i++){
+        table_append(&table);
+        if (presize){
+            row_reserve(&table.arena, &table.rows[i], cols);
+        }
+        for (int j = 0; j < cols; j++){
+            row_append(&table.arena, &table.rows[i]);
+            cell_append(&table.arena, &table.rows[i].cells[j], 'x');
+        }
+    }
+    double t = now() - t0;
+    table_destroy(&table);
+    return t;
+}
+
+int main(int argc, char **argv){
+    int max_rows = argc > 1 ? atoi(argv[1]) : 10000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 4;
+
+    printf("%10s %12s %12s %14s\n", "rows", "append [s]", "ns/row", "presized [s]");
+    for (int rows = max_rows / 8; rows <= max_rows && rows > 0; rows *= 2){
+        double t = fill(rows, cols, false);
+        double tp = fill(rows, cols, true);
+        printf("%10d %12.3f %12.1f %14.3f\n", rows, t, t / rows * 1e9, tp);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * @file: bench/kernels.c
+ * @brief: Compare count and min/max kernels of every instruction set with the scalar
+ *         ones (results must be identical) and time them
+ *
+ * usage: ./bench_kernels [N] [REPEAT]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Fill arrays with values containing ties, infinities, NaN and missing numbers
+ * @param nan: put NaN among valid values
+ */
+void generate(double *vals, unsigned char *ok, int n, bool nan){
+    for (int i = 0; i < n; i++){
+        int r = rand();
+        vals[i] = (r % 1000) - 500 + (r % 7) / 4.0;
+        ok[i] = r % 5 != 0;
+    }
+    if (n > 3){
+        vals[n/3] = HUGE_VAL;
+        ok[n/3] = rand() % 2;
+        vals[n/2] = -HUGE_VAL;
+        ok[n/2] = rand() % 2;
+        if (nan){
+            vals[rand() % n] = NAN;
+        }
+    }
+}
+
+/* Check kernels on many sizes (including sizes not divisible by vector width)
+ * @return: number of mismatches against scalar kernels
+ */
+int verify(const Kernels *k){
+    int errors = 0;
+    for (int n = 0; n < 300; n++){
+        for (int t = 0; t < 20; t++){
+            double vals[300];
+            unsigned char ok[300];
+            generate(vals, ok, n, t % 4 == 0);
+            for (int max = 0; max < 2; max++){
+                if (k->arg_extreme(vals, ok, n, max) != arg_extreme_scalar(vals, ok, n, max))
+                    errors++;
+            }
+            if (k->count(ok, n) != count_scalar(ok, n))
+                errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv){
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    int repeat = argc > 2 ? atoi(argv[2]) : 20;
+    const Kernels *all[] = {
+        &kernels_scalar,
+#ifdef SPS_X86
+        &kernels_sse2, &kernels_avx2,
+#endif
+    };
+    const Kernels *best = kernels_get();
+
+    double *vals = malloc(n * sizeof(double));
+    unsigned char *ok = malloc(n);
+    if (vals == NULL || ok == NULL){
+        return 1;
+    }
+    generate(vals, ok, n, false);
+
+    printf("selected kernels: %s\n", best->name);
+    printf("%8s %10s %12s %12s\n", "kernels", "mismatch", "max [ms]", "count [ms]");
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++){
+#ifdef SPS_X86
+        if (all[i] == &kernels_avx2 && !__builtin_cpu_supports("avx2"))
+            continue;
+#endif
+        int errors = verify(all[i]);
+        failed |= errors != 0;
+        volatile int sink = 0;
+        double t0 = now();
+        for (int r = 0; r < repeat; r++)
+            sink += all[i]->arg_extreme(vals, ok, n, r % 2);
+        double t1 = now();
+        for (int r = 0; r < repeat; r++)
+            sink += all[i]->count(ok, n);
+        double t2 = now();
+        printf("%8s %10d %12.2f %12.2f\n", all[i]->name, errors, 
+               (t1 - t0) / repeat * 1e3, (t2 - t1) / repeat * 1e3);
+    }
+
+    free(vals);
+    free(ok);
+    return failed;
+}
@@ -0,0 +1,98 @@
+/*
+ * @file: bench/lazy.c
+ * @brief: Time of the whole processing of a file (load, commands and print) with all rows
+ *         parsed compared with lazy loading (-l), which parses only rows touched by commands,
+ *         both outputs have to be equal, outputs of small edge cases (a row without '\n',
+ *         no complete row, quotes over more lines) are compared too
+ *
+ * usage: ./bench_lazy [ROWS] [COLS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Process file by the command sequence like sps with given options
+ * @param lazy: "-l" or "-m"
+ * @param out: destination of the output
+ * @return: time of processing in seconds, negative if it failed
+ */
+double run(char *lazy, char *cmds, char *path, FILE *out){
+    char *argv[] = {"sps", "-d", ":", lazy, cmds, path};
+    Args args = {argv, 6};
+    Options opts;
+    Program prog;
+    char seq[strlen(cmds)+1];
+    strcpy(seq, cmds);
+    if (parse_options(args, &opts) || compile_program(&prog, seq, NULL)){
+        return -1;
+    }
+    double t0 = now();
+    int status = process_file(&opts, &prog, path, out);
+    fflush(out);
+    double t1 = now();
+    program_destroy(&prog);
+    return status == FILE_OK ? t1 - t0 : -1;
+}
+
+/* Process file with all rows parsed and lazily, print the time of both
+ * @return: 0 if outputs are equal, 1 otherwise
+ */
+int compare(char *cmds, char *path){
+    FILE *full = tmpfile(), *lazy = tmpfile();
+    if (full == NULL || lazy == NULL){
+        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        return 1;
+    }
+    double t_full = run("-m", cmds, path, full);
+    double t_lazy = run("-l", cmds, path, lazy);
+    int status = 0;
+    if (t_full < 0 || t_lazy < 0 || !files_equal(full, lazy)){
+        fprintf(stderr, "%s: outputs differ\n", cmds);
+        status = 1;
+    }
+    printf("%-40s %10.3f %10.3f\n", cmds, t_full, t_lazy);
+    fclose(full);
+    fclose(lazy);
+    return status;
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 6;
+    char *commands[] = {"[2,1];set x;[1000,3];clear", "[10,1,20,-];[find alpha];set y",
+                        "[5,1];drow;[7,1];irow;[9,2];set z", "[_,2];sum [1,1]"};
+
+    char path[] = "/tmp/bench_lazy.XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "w");
+    if (f == NULL){
+        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        return 1;
+    }
+    generate_file(f, rows, cols, 8);
+    fclose(f);
+
+    printf("%d rows, %d cols\n", rows, cols);
+    printf("%-40s %10s %10s\n", "commands", "mmap [s]", "lazy [s]");
+    int status = 0;
+    for (size_t k = 0; k < sizeof(commands) / sizeof(commands[0]); k++){
+        status |= compare(commands[k], path);
+    }
+
+    const char *edges[] = {"2.5:1", "2.5:1\n\nx:y", "\"a:\nb\":c\nd:e\n"};
+    for (size_t k = 0; k < sizeof(edges) / sizeof(edges[0]); k++){
+        f = fopen(path, "w");
+        if (f == NULL || fputs(edges[k], f) == EOF || fclose(f)){
+            fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+            status = 1;
+            break;
+        }
+        status |= compare("[1,_];set A", path);
+        status |= compare("[2,1];set B;[_,2];clear", path);
+    }
+    unlink(path);
+    return status;
+}
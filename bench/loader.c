@@ -0,0 +1,127 @@
+/*
+ * @file: bench/loader.c
+ * @brief: Throughput of the block loader (create_table) compared with
+ *         the original per-character fgetc loader and throughput of the
+ *         parallel loader (create_table_parallel) on 2 to 8 threads
+ *
+ * usage: ./bench_loader [FILE] [DELIMS]
+ *        without FILE a synthetic table is generated into a temporary file
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Original loader, reads input one character at a time */
+bool isdelim(char c, char *delims){
+    for (size_t i = 0; i < strlen(delims); i++){
+        if (c == delims[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void create_table_fgetc(Table *table, FILE *source, char *delims){
+    int c, current_cell = 0, current_row = 0;
+    int quotes_active = -1;
+
+    while ((c = fgetc(source)) != EOF){
+        if (table->rows == NULL){
+            table_append(table); 
+        }
+        if (table->rows[current_row].cells == NULL){
+            row_append(&table->arena, &table->rows[current_row]);
+        }
+
+        if (c == '\n'){ 
+            current_cell = 0;
+            current_row++;
+            table_append(table); 
+            continue;
+        } 
+        else if (c == '"'){
+            quotes_active *= -1;
+        } 
+        else if (c == '\\'){           
+            if ((c = fgetc(source)) != EOF){
+                if (isdelim(c, delims)){
+                    table->rows[current_row].cells[current_cell].delim = true;
+                }
+                cell_append(&table->arena, &table->rows[current_row].cells[current_cell], c);
+                continue;
+            }
+        }
+
+        if (isdelim(c, delims) && quotes_active == -1){
+            current_cell++;
+            row_append(&table->arena, &table->rows[current_row]);
+            continue;
+        }
+        if (isdelim(c, delims)){
+            table->rows[current_row].cells[current_cell].delim = true;
+        }
+        if (c != '"'){
+            cell_append(&table->arena, &table->rows[current_row].cells[current_cell], c);
+        }
+    }
+    row_destroy(&table->arena, &table->rows[table->size]-1);
+    table->size--;
+}
+
+int main(int argc, char **argv){
+    char *delims = argc > 2 ? argv[2] : ":";
+    FILE *f;
+    if (argc > 1){
+        f = fopen(argv[1], "r");
+    } else {
+        f = tmpfile();
+        if (f != NULL)
+            generate_file(f, 200000, 8, 2);
+    }
+    if (f == NULL){
+        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    double mb = ftell(f) / 1e6;
+
+    Table old_t, new_t;
+    table_init(&old_t);
+    table_init(&new_t);
+
+    rewind(f);
+    double t0 = now();
+    create_table_fgetc(&old_t, f, delims);
+    double t1 = now();
+    rewind(f);
+    create_table(&new_t, f, delims);
+    double t2 = now();
+
+    printf("input: %.1f MB, %d rows\n", mb, new_t.size);
+    printf("fgetc loader: %8.1f MB/s\n", mb / (t1 - t0));
+    printf("block loader: %8.1f MB/s\n", mb / (t2 - t1));
+    printf("tables %s\n", tables_equal(&old_t, &new_t) ? "equal" : "DIFFER");
+
+    for (int threads = 2; threads <= 8; threads *= 2){
+        Table par_t;
+        table_init(&par_t);
+        rewind(f);
+        double t3 = now();
+        if (create_table_parallel(&par_t, f, delims, threads, false)){
+            printf("parallel loader: input is too small\n");
+            break;
+        }
+        double t4 = now();
+        printf("parallel loader (%d threads): %8.1f MB/s, tables %s\n", threads, mb / (t4 - t3),
+               tables_equal(&par_t, &new_t) ? "equal" : "DIFFER");
+        table_destroy(&par_t);
+    }
+
+    table_destroy(&old_t);
+    table_destroy(&new_t);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * @file: bench/snapshot.c
+ * @brief: Time of loading a table from text (create_table) compared with
+ *         loading it from a binary snapshot (create_table_snapshot), which leaves
+ *         rows unparsed, and time of printing both tables the way process_file prints
+ *         them (excess_columns and table_print), outputs must be equal
+ *         and so must be the tables, when all rows of the snapshot are parsed
+ *
+ * usage: ./bench_snapshot [FILE] [DELIMS]
+ *        without FILE a synthetic table is generated into a temporary file
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Remove excess columns and print table to a temporary file
+ * @return: the file, NULL if it could not be written
+ */
+FILE * print(Table *table, char delim){
+    FILE *f = tmpfile();
+    Writer w;
+    if (f == NULL || writer_open(&w, f)){
+        return NULL;
+    }
+    excess_columns(table);
+    table_print(table, delim, &w);
+    if (writer_close(&w) || table->damaged){
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+int main(int argc, char **argv){
+    char *delims = argc > 2 ? argv[2] : ":";
+    FILE *f;
+    if (argc > 1){
+        f = fopen(argv[1], "r");
+    } else {
+        f = tmpfile();
+        if (f != NULL)
+            generate_file(f, 500000, 8, 2);
+    }
+    char path[] = "/tmp/bench_snapshot.XXXXXX";
+    int fd = mkstemp(path);
+    if (f == NULL || fd < 0){
+        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        return 1;
+    }
+    close(fd);
+    fseek(f, 0, SEEK_END);
+    double mb = ftell(f) / 1e6;
+
+    Table text_t, snap_t;
+    table_init(&text_t);
+    table_init(&snap_t);
+
+    rewind(f);
+    double t0 = now();
+    create_table(&text_t, f, delims);
+    double t1 = now();
+    int error = snapshot_write(&text_t, path);
+    double t2 = now();
+    FILE *s = error ? NULL : fopen(path, "r");
+    if (s == NULL || create_table_snapshot(&snap_t, s)){
+        fprintf(stderr, "Snapshot sa nepodarilo zapisat alebo nacitat\n");
+        unlink(path);
+        return 1;
+    }
+    double t3 = now();
+    FILE *text_out = print(&text_t, delims[0]);
+    double t4 = now();
+    FILE *snap_out = print(&snap_t, delims[0]);
+    double t5 = now();
+    fseek(s, 0, SEEK_END);
+
+    printf("input: %.1f MB, snapshot: %.1f MB, %d rows\n", mb, ftell(s) / 1e6, text_t.size);
+    printf("text load:      %8.3f s\n", t1 - t0);
+    printf("snapshot save:  %8.3f s\n", t2 - t1);
+    printf("snapshot load:  %8.3f s (%.1fx faster)\n", t3 - t2, (t1 - t0) / (t3 - t2));
+    printf("text print:     %8.3f s\n", t4 - t3);
+    printf("snapshot print: %8.3f s\n", t5 - t4);
+    bool equal = text_out != NULL && snap_out != NULL && files_equal(text_out, snap_out);
+    printf("outputs %s\n", equal ? "equal" : "DIFFER");
+    table_parse(&snap_t, 1, snap_t.size);
+    printf("tables %s\n", tables_equal(&text_t, &snap_t) && !snap_t.damaged ? "equal" : "DIFFER");
+
+    table_destroy(&text_t);
+    table_destroy(&snap_t);
+    if (text_out != NULL)
+        fclose(text_out);
+    if (snap_out != NULL)
+        fclose(snap_out);
+    fclose(s);
+    fclose(f);
+    unlink(path);
+    return 0;
+}
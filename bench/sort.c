@@ -0,0 +1,105 @@
+/*
+ * @file: bench/sort.c
+ * @brief: Time of sort command over all rows of a table with numeric and lexical
+ *         keys, compared with qsort of row headers, which compares cell texts
+ *         and parses numbers in every comparison
+ *
+ * usage: ./bench_sort [ROWS] [COLS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Table with pseudo-random numbers in the first column and row index in the last one */
+void build(Table *table, int rows, int cols){
+    char buf[32];
+    unsigned seed = 1;
+    table_init(table);
+    table_reserve(table, rows);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        Row *row = &table->rows[i];
+        row_reserve(&table->arena, row, cols);
+        for (int j = 0; j < cols; j++){
+            seed = seed * 1103515245 + 12345;
+            int len = j == cols-1 ? sprintf(buf, "%d", i) : 
+                                    sprintf(buf, "%.3f", (seed >> 8) % 100000 / 7.0);
+            row_append(&table->arena, row);
+            for (int k = 0; k < len; k++){
+                cell_append(&table->arena, &row->cells[j], buf[k]);
+            }
+        }
+    }
+}
+
+/* Check, that rows are ordered and rows with equal keys keep their original order */
+bool check(Table *table, bool numeric){
+    for (int i = 1; i < table->size; i++){
+        Cell *a = &table->rows[i-1].cells[0], *b = &table->rows[i].cells[0];
+        char ta[a->size+1], tb[b->size+1];
+        get_cell_text(a, ta);
+        get_cell_text(b, tb);
+        int cmp = numeric ? (atof(ta) > atof(tb)) - (atof(ta) < atof(tb)) : strcmp(ta, tb);
+        if (cmp > 0){
+            return false;
+        }
+        Row *ra = &table->rows[i-1], *rb = &table->rows[i];
+        if (cmp == 0 && atoi(ra->cells[ra->size-1].text) > atoi(rb->cells[rb->size-1].text)){
+            return false;
+        }
+    }
+    return true;
+}
+
+int compare_lex(const void *a, const void *b){
+    const Cell *ca = &((const Row *)a)->cells[0], *cb = &((const Row *)b)->cells[0];
+    char ta[ca->size+1], tb[cb->size+1];
+    get_cell_text((Cell *)ca, ta);
+    get_cell_text((Cell *)cb, tb);
+    return strcmp(ta, tb);
+}
+
+int compare_num(const void *a, const void *b){
+    const Cell *ca = &((const Row *)a)->cells[0], *cb = &((const Row *)b)->cells[0];
+    char ta[ca->size+1], tb[cb->size+1];
+    get_cell_text((Cell *)ca, ta);
+    get_cell_text((Cell *)cb, tb);
+    double x = atof(ta), y = atof(tb);
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 4;
+
+    printf("%d rows, %d cols\n", rows, cols);
+    printf("%-6s %12s %12s\n", "keys", "sort [s]", "qsort [s]");
+    for (int numeric = 0; numeric < 2; numeric++){
+        Table table;
+        build(&table, rows, cols);
+        Selection sc = {1, rows, 1, cols};
+        Instr ins = {OP_SORT, {0, numeric, 0, 0}, -1};
+        double t0 = now();
+        if (sort_selection(&sc, &table, &ins)){
+            fprintf(stderr, "sort: nedostatok pamate\n");
+            return 1;
+        }
+        double t = now() - t0;
+        if (!check(&table, numeric)){
+            fprintf(stderr, "sort: rows are not in stable order\n");
+            return 1;
+        }
+        table_destroy(&table);
+
+        build(&table, rows, cols);
+        t0 = now();
+        qsort(table.rows, table.size, sizeof(Row), numeric ? compare_num : compare_lex);
+        double tq = now() - t0;
+        table_destroy(&table);
+        printf("%-6s %12.3f %12.3f\n", numeric ? "num" : "lex", t, tq);
+    }
+    return 0;
+}
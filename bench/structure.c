@@ -0,0 +1,195 @@
+/*
+ * @file: bench/structure.c
+ * @brief: Time of deleting every other row (column) of a table through an open gap,
+ *         compared with shifting the rest of the table after every deletion, which
+ *         is quadratic, and time of drow/dcol over a half of the table
+ *         icol and acol followed by removing of excess columns have to keep every cell
+ *
+ * usage: ./bench_structure [ROWS] [COLS]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Table where text of every cell is its row index
+ * @param rows, cols: size of the table
+ */
+void build(Table *table, int rows, int cols){
+    char buf[16];
+    table_init(table);
+    table_reserve(table, rows);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        Row *row = &table->rows[i];
+        row_reserve(&table->arena, row, cols);
+        int len = sprintf(buf, "%d", i);
+        for (int j = 0; j < cols; j++){
+            row_append(&table->arena, row);
+            for (int k = 0; k < len; k++){
+                cell_append(&table->arena, &row->cells[j], buf[k]);
+            }
+        }
+    }
+}
+
+/* Remaining rows must be the odd ones of the original table
+ * @return: true if they are
+ */
+bool check_rows(Table *table, int rows){
+    if (table->size != rows / 2){
+        return false;
+    }
+    for (int i = 0; i < table->size; i++){
+        if (atoi(table->rows[i].cells[0].text) != 2*i + 1){
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Delete every other row of the table
+ * @param gap: delete through gap of the table, else shift the table after each deletion
+ * @return: time in seconds
+ */
+double delete_rows(int rows, int cols, bool gap){
+    Table table;
+    build(&table, rows, cols);
+    double t0 = now();
+    if (gap){
+        Gap g = table_gap_open(&table);
+        for (int i = 0; i < table.size; i++){
+            table_gap_delete(&table, &g, i, 1);
+        }
+        table_gap_close(&table, &g);
+    } else {
+        for (int i = 0; i < table.size; i++){
+            row_destroy(&table.arena, &table.rows[i]);
+            for (int k = i+1; k < table.size; k++){
+                memcpy(&table.rows[k-1], &table.rows[k], sizeof(Row));
+            }
+            table.size--;
+        }
+    }
+    double t = now() - t0;
+    if (!check_rows(&table, rows)){
+        fprintf(stderr, "drow: wrong result for %d rows\n", rows);
+        exit(1);
+    }
+    table_destroy(&table);
+    return t;
+}
+
+/* Delete every other column of one wide row
+ * @return: time in seconds
+ */
+double delete_cols(int cols){
+    Table table;
+    build(&table, 1, cols);
+    Row *row = &table.rows[0];
+    for (int j = 0; j < cols; j++){
+        cell_rewrite(&table.arena, &row->cells[j], "", " ");
+        char buf[16];
+        sprintf(buf, "%d", j);
+        for (int k = 0; buf[k]; k++){
+            cell_append(&table.arena, &row->cells[j], buf[k]);
+        }
+    }
+    double t0 = now();
+    Gap g = row_gap_open(row);
+    for (int j = 0; j < row->size; j++){
+        row_gap_delete(&table.arena, row, &g, j, 1);
+    }
+    row_gap_close(row, &g);
+    double t = now() - t0;
+    bool ok = row->size == cols / 2;
+    for (int j = 0; ok && j < row->size; j++){
+        ok = atoi(row->cells[j].text) == 2*j + 1;
+    }
+    if (!ok){
+        fprintf(stderr, "dcol: wrong result for %d columns\n", cols);
+        exit(1);
+    }
+    table_destroy(&table);
+    return t;
+}
+
+/* Delete the second half of rows with drow, then the second half of columns with dcol
+ * @return: time in seconds
+ */
+double delete_half(int rows, int cols){
+    Table table;
+    build(&table, rows, cols);
+    double t0 = now();
+    Selection sc = {rows/2 + 1, rows, cols/2 + 1, cols};
+    edit_tstruc(&sc, OP_DROW, &table, " ");
+    sc.end_row = table.size;
+    edit_tstruc(&sc, OP_DCOL, &table, " ");
+    double t = now() - t0;
+    bool ok = table.size == rows/2;
+    for (int i = 0; ok && i < table.size; i++){
+        ok = table.rows[i].size == cols/2 && atoi(table.rows[i].cells[0].text) == i;
+    }
+    if (!ok){
+        fprintf(stderr, "drow/dcol: wrong result for %d rows\n", rows);
+        exit(1);
+    }
+    table_destroy(&table);
+    return t;
+}
+
+/* Insert two empty columns before the first one and one after the last one, 
+ * then remove excess columns as before printing
+ * @return: time in seconds
+ */
+double insert_cols(int rows, int cols){
+    Table table;
+    build(&table, rows, cols);
+    double t0 = now();
+    Selection sc = {1, 1, 1, 2};
+    edit_tstruc(&sc, OP_ICOL, &table, " ");
+    sc = (Selection){1, 1, cols+2, cols+2};
+    edit_tstruc(&sc, OP_ACOL, &table, " ");
+    fill_table(&table);
+    excess_columns(&table);
+    double t = now() - t0;
+    bool ok = true;
+    for (int i = 0; ok && i < table.size; i++){
+        Row *row = &table.rows[i];
+        ok = row->size == cols+2 && cell_empty(&row->cells[0]) && cell_empty(&row->cells[1]);
+        for (int j = 2; ok && j < row->size; j++){
+            ok = !cell_empty(&row->cells[j]) && atoi(row->cells[j].text) == i;
+        }
+    }
+    if (!ok){
+        fprintf(stderr, "icol/acol: cells were lost for %d rows\n", rows);
+        exit(1);
+    }
+    table_destroy(&table);
+    return t;
+}
+
+int main(int argc, char **argv){
+    int max_rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 4;
+
+    printf("%10s %12s %12s %12s\n", "rows", "gap [s]", "shift [s]", "half [s]");
+    for (int rows = max_rows / 16; rows <= max_rows && rows > 0; rows *= 2){
+        double t = delete_rows(rows, cols, true);
+        double th = delete_half(rows, cols);
+        if (rows <= max_rows / 8){
+            printf("%10d %12.3f %12.3f %12.3f\n", rows, t, delete_rows(rows, cols, false), th);
+        } else {
+            printf("%10d %12.3f %12s %12.3f\n", rows, t, "-", th);
+        }
+    }
+    printf("%10s %12s\n", "rows", "icol [s]");
+    printf("%10d %12.3f\n", max_rows, insert_cols(max_rows, cols));
+    printf("%10s %12s\n", "cols", "gap [s]");
+    for (int n = max_rows / 16; n <= max_rows && n > 0; n *= 4){
+        printf("%10d %12.3f\n", n, delete_cols(n));
+    }
+    return 0;
+}
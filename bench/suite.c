@@ -0,0 +1,331 @@
+/*
+ * @file: bench/suite.c
+ * @brief: Benchmark suite over a generated table, times loading, every family of
+ *         commands (selections, table structure, table data, variables) and printing
+ *         and writes the results as JSON or CSV. The generator is deterministic, so
+ *         results of the same options are comparable across commits
+ *
+ * usage: ./bench_suite [-r ROWS] [-c COLS] [-l MIN:MAX] [-z SKEW] [-n NUMERIC]
+ *                      [-q QUOTES] [-e ESCAPES] [-d DELIMS] [-s SEED] [-k REPEATS]
+ *                      [-f json|csv] [-g FILE]
+ *        -l: length of text cells, MIN + (MAX-MIN+1) * u^SKEW for uniform u in [0,1)
+ *        -n, -q, -e: ratio of numeric cells, of text cells with a quoted delimiter
+ *                    and of text cells with an escaped delimiter
+ *        -g: only write the generated table to FILE
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+#ifndef SPS_REVISION
+#define SPS_REVISION "unknown" //commit of sps.c, set by makefile
+#endif
+
+//Parameters of the generated table
+typedef struct {
+    int rows;
+    int cols;
+    int min_len, max_len; //length of text cells
+    double skew; //1 for uniform lengths, more for more short cells
+    double numeric; //ratio of numeric cells
+    double quotes; //ratio of text cells containing a delimiter in quotes
+    double escapes; //ratio of text cells containing an escaped delimiter
+    char *delims; //cells are separated by random delimiters of the set
+    unsigned long long seed;
+} GenConfig;
+
+//One timed command sequence
+typedef struct {
+    const char *family;
+    const char *name;
+    const char *cmd;
+} Case;
+
+//Timed cases, every one runs over a freshly loaded table
+const Case cases[] = {
+    {"selection", "max", "[_,_];[max]"},
+    {"selection", "min", "[_,_];[min]"},
+    {"selection", "find", "[_,_];[find missing]"},
+    {"selection", "contains", "[_,_];[contains zzz]"},
+    {"selection", "regex", "[_,_];[regex ^a+b$]"},
+    {"structure", "irow", "[_,1];irow"},
+    {"structure", "drow", "[_,1];drow"},
+    {"structure", "icol", "[_,2];icol"},
+    {"structure", "dcol", "[_,2];dcol"},
+    {"structure", "clear", "[_,_];clear"},
+    {"structure", "sort", "[_,1];sort num"},
+    {"data", "set", "[_,_];set x"},
+    {"data", "sum", "[_,_];sum [1,1]"},
+    {"data", "avg", "[_,_];avg [1,1]"},
+    {"data", "count", "[_,_];count [1,1]"},
+    {"data", "swap", "[_,1];swap [1,2]"},
+    {"data", "group", "[_,_];group sum 1"},
+    {"variables", "def+use", "[1,1];def _0;[_,_];use _0"},
+    {"variables", "inc", "inc _0;inc _0;inc _0;[1,1];use _0"},
+};
+
+/* Next pseudo-random number (splitmix64), same on every platform */
+unsigned long long next_random(unsigned long long *state){
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform number in [0,1) */
+double next_unit(unsigned long long *state){
+    return (next_random(state) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/* Write one text cell, a delimiter is placed into quotes or escaped with '\\' */
+void generate_text(FILE *f, GenConfig *cfg, unsigned long long *state){
+    int len = cfg->min_len + (int)((cfg->max_len - cfg->min_len + 1) * pow(next_unit(state), cfg->skew));
+    double kind = next_unit(state);
+    bool quoted = kind < cfg->quotes;
+    bool escaped = !quoted && kind < cfg->quotes + cfg->escapes;
+    if (quoted){
+        fputc('"', f);
+    }
+    for (int k = 0; k < len; k++){
+        if ((quoted || escaped) && k == len / 2){
+            if (escaped){
+                fputc('\\', f);
+            }
+            fputc(cfg->delims[next_random(state) % strlen(cfg->delims)], f);
+        }
+        fputc('a' + next_random(state) % 26, f);
+    }
+    if (quoted){
+        fputc('"', f);
+    }
+}
+
+/* Write the generated table to a file */
+void generate(FILE *f, GenConfig *cfg){
+    unsigned long long state = cfg->seed;
+    size_t ndelims = strlen(cfg->delims);
+    for (int i = 0; i < cfg->rows; i++){
+        for (int j = 0; j < cfg->cols; j++){
+            if (next_unit(&state) < cfg->numeric){
+                long long value = (long long)(next_random(&state) % 2000000) - 1000000;
+                fprintf(f, "%lld.%03d", value, (int)(next_random(&state) % 1000));
+            } else {
+                generate_text(f, cfg, &state);
+            }
+            if (j != cfg->cols-1){
+                fputc(cfg->delims[next_random(&state) % ndelims], f);
+            }
+        }
+        fputc('\n', f);
+    }
+}
+
+int compare_doubles(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Times of one measured operation */
+typedef struct {
+    const char *family;
+    const char *name;
+    double min;
+    double median;
+} Result;
+
+/* Minimum and median of repeated times, times are sorted */
+Result summarize(const char *family, const char *name, double *times, int repeats){
+    qsort(times, repeats, sizeof(double), compare_doubles);
+    Result r = {family, name, times[0], times[repeats / 2]};
+    return r;
+}
+
+/* Load the generated table
+ * @param how: 0 for create_table, 1 for create_table_mmap, 2 for create_table_parallel
+ * @return: time of loading in seconds
+ */
+double load(Table *table, FILE *f, GenConfig *cfg, int how){
+    table_init(table);
+    rewind(f);
+    double t0 = now();
+    if (how == 1){
+        create_table_mmap(table, f, cfg->delims);
+    } else if (how == 2){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (create_table_parallel(table, f, cfg->delims, cpus > 1 ? cpus : 2, false)){
+            create_table(table, f, cfg->delims);
+        }
+    } else {
+        create_table(table, f, cfg->delims);
+    }
+    fill_table(table);
+    return now() - t0;
+}
+
+/* Time one command sequence over a loaded table, selection output goes to /dev/null
+ * @return: time in seconds, negative if the sequence failed
+ */
+double run_case(const Case *c, FILE *f, FILE *null, GenConfig *cfg){
+    Table table;
+    load(&table, f, cfg, 0);
+    char cmd[strlen(c->cmd) + 1];
+    strcpy(cmd, c->cmd);
+
+    double t0 = now();
+    Program prog;
+    if (compile_program(&prog, cmd, NULL)){
+        table_destroy(&table);
+        return -1;
+    }
+    Selection sc = {1, 1, 1, 1}, tmp_sc = {1, 1, 1, 1};
+    Temporary tmp_vars;
+    variables_init(&tmp_vars);
+    int failed = run_program(&prog, &sc, &tmp_sc, &table, &tmp_vars, cfg->delims, null);
+    double t = now() - t0;
+
+    program_destroy(&prog);
+    variables_destroy(&tmp_vars);
+    table_destroy(&table);
+    return failed ? -1 : t;
+}
+
+/* Time printing of a loaded table through the writer into /dev/null */
+double print_table(FILE *f, FILE *null, GenConfig *cfg){
+    Table table;
+    load(&table, f, cfg, 0);
+    Writer w;
+    double t0 = now();
+    if (writer_open(&w, null)){
+        table_destroy(&table);
+        return -1;
+    }
+    table_print(&table, cfg->delims[0], &w);
+    writer_close(&w);
+    double t = now() - t0;
+    table_destroy(&table);
+    return t;
+}
+
+/* Parse options of the suite
+ * @return: 0 if successful, 1 if they are invalid
+ */
+int parse_suite_options(int argc, char **argv, GenConfig *cfg, int *repeats, char **format,
+                        char **gen_file){
+    for (int i = 1; i < argc; i++){
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i+1 >= argc){
+            return 1;
+        }
+        char *arg = argv[++i];
+        int ok = 1;
+        switch (argv[i-1][1]){
+            case 'r': ok = sscanf(arg, "%d", &cfg->rows) == 1 && cfg->rows > 0; break;
+            case 'c': ok = sscanf(arg, "%d", &cfg->cols) == 1 && cfg->cols > 1; break;
+            case 'l': ok = sscanf(arg, "%d:%d", &cfg->min_len, &cfg->max_len) == 2 &&
+                           cfg->min_len >= 1 && cfg->max_len >= cfg->min_len; break;
+            case 'z': ok = sscanf(arg, "%lf", &cfg->skew) == 1 && cfg->skew > 0; break;
+            case 'n': ok = sscanf(arg, "%lf", &cfg->numeric) == 1; break;
+            case 'q': ok = sscanf(arg, "%lf", &cfg->quotes) == 1; break;
+            case 'e': ok = sscanf(arg, "%lf", &cfg->escapes) == 1; break;
+            case 'd': cfg->delims = arg; ok = strpbrk(arg, "\"\\\n") == NULL && arg[0]; break;
+            case 's': ok = sscanf(arg, "%llu", &cfg->seed) == 1; break;
+            case 'k': ok = sscanf(arg, "%d", repeats) == 1 && *repeats > 0; break;
+            case 'f': *format = arg; ok = !strcmp(arg, "json") || !strcmp(arg, "csv"); break;
+            case 'g': *gen_file = arg; break;
+            default: ok = 0;
+        }
+        if (!ok){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Write configuration and results as one JSON object or as CSV rows */
+void report(FILE *dst, char *format, GenConfig *cfg, double mb, int repeats, Result *res, int n){
+    if (!strcmp(format, "csv")){
+        fprintf(dst, "revision,rows,cols,seed,family,name,min_s,median_s\n");
+        for (int k = 0; k < n; k++){
+            fprintf(dst, "%s,%d,%d,%llu,%s,%s,%.6f,%.6f\n", SPS_REVISION, cfg->rows, cfg->cols,
+                    cfg->seed, res[k].family, res[k].name, res[k].min, res[k].median);
+        }
+        return;
+    }
+    fprintf(dst, "{\n  \"revision\": \"%s\",\n", SPS_REVISION);
+    fprintf(dst, "  \"config\": {\"rows\": %d, \"cols\": %d, \"min_len\": %d, \"max_len\": %d, "
+            "\"skew\": %g, \"numeric\": %g, \"quotes\": %g, \"escapes\": %g, \"delims\": \"",
+            cfg->rows, cfg->cols, cfg->min_len, cfg->max_len, cfg->skew, cfg->numeric,
+            cfg->quotes, cfg->escapes);
+    for (char *d = cfg->delims; *d; d++){
+        fprintf(dst, (unsigned char)*d < 0x20 ? "\\u%04x" : "%c", *d);
+    }
+    fprintf(dst, "\", \"seed\": %llu, \"repeats\": %d, \"input_mb\": %.3f},\n",
+            cfg->seed, repeats, mb);
+    fprintf(dst, "  \"results\": [\n");
+    for (int k = 0; k < n; k++){
+        fprintf(dst, "    {\"family\": \"%s\", \"name\": \"%s\", \"min_s\": %.6f, \"median_s\": %.6f}%s\n",
+                res[k].family, res[k].name, res[k].min, res[k].median, k == n-1 ? "" : ",");
+    }
+    fprintf(dst, "  ]\n}\n");
+}
+
+int main(int argc, char **argv){
+    GenConfig cfg = {200000, 6, 1, 12, 2.0, 0.5, 0.05, 0.02, ":", 1};
+    int repeats = 5;
+    char *format = "json", *gen_file = NULL;
+    if (parse_suite_options(argc, argv, &cfg, &repeats, &format, &gen_file)){
+        fprintf(stderr, "Chybne zadane argumenty\n");
+        return 1;
+    }
+    FILE *f = gen_file != NULL ? fopen(gen_file, "w+") : tmpfile();
+    FILE *null = fopen("/dev/null", "w");
+    if (f == NULL || null == NULL){
+        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        return 1;
+    }
+    generate(f, &cfg);
+    fflush(f);
+    if (gen_file != NULL){
+        fclose(f);
+        fclose(null);
+        return 0;
+    }
+    double mb = ftell(f) / 1e6;
+
+    int ncases = sizeof(cases) / sizeof(cases[0]);
+    Result res[ncases + 4];
+    double times[repeats];
+    int n = 0;
+    const char *loaders[] = {"create_table", "create_table_mmap", "create_table_parallel"};
+    for (int how = 0; how < 3; how++){
+        for (int r = 0; r < repeats; r++){
+            Table table;
+            times[r] = load(&table, f, &cfg, how);
+            table_destroy(&table);
+        }
+        res[n++] = summarize("load", loaders[how], times, repeats);
+    }
+    for (int k = 0; k < ncases; k++){
+        for (int r = 0; r < repeats; r++){
+            if ((times[r] = run_case(&cases[k], f, null, &cfg)) < 0){
+                fprintf(stderr, "%s: prikazy sa nepodarilo vykonat\n", cases[k].name);
+                return 1;
+            }
+        }
+        res[n++] = summarize(cases[k].family, cases[k].name, times, repeats);
+    }
+    for (int r = 0; r < repeats; r++){
+        if ((times[r] = print_table(f, null, &cfg)) < 0){
+            fprintf(stderr, "Nedostatok pamate\n");
+            return 1;
+        }
+    }
+    res[n++] = summarize("print", "table_print", times, repeats);
+
+    report(stdout, format, &cfg, mb, repeats, res, n);
+    fclose(f);
+    fclose(null);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# @file: bench/train.sh
+# @brief: Training run of the profile-guided build (make sps_pgo), instrumented sps
+#         processes generated tables and the fixtures with commands of every family
+#         and with every loader and option, which changes the executed code
+#
+# usage: bench/train.sh SPS SUITE
+#        SPS: instrumented sps binary, SUITE: bench_suite used to generate tables
+#
+
+set -e
+sps=$1
+suite=$2
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+"$suite" -r 200000 -c 6 -g "$dir/mixed.txt"
+"$suite" -r 200000 -c 4 -n 0.9 -q 0 -e 0 -g "$dir/numeric.txt"
+"$suite" -r 50000 -c 8 -l 4:40 -n 0.2 -q 0.2 -e 0.1 -d ':,;' -g "$dir/text.txt"
+cp tab official "$dir/"
+
+for opts in "" "-m" "-c" "-f" "-t 4" "-m -t 4 -c"; do
+    for cmds in "[1,1]" \
+                "[_,_];[max];[_,_];[min];[_,_];[find 123];[_,_];[contains ab]" \
+                "[_,_];[prefix a];[_,_];[regex ^1.*5$]" \
+                "[_,1];sort num;[_,2];sort desc;[_,1];group sum 2;[_,1];group count 3" \
+                "[_,2];sum [1,1];[_,3];avg [1,2];[_,_];count [1,3];[2,2];len [1,4]" \
+                "[_,2];set x;[_,3];clear;[1,1];def _0;[_,4];use _0;inc _1;[_,1];swap [1,2]" \
+                "[2,1,100,1];irow;[_,2];icol;[3,1,50,1];drow;[_,3];dcol;[_,1];arow;[_,1];acol"; do
+        for file in "$dir/mixed.txt" "$dir/numeric.txt"; do
+            # shellcheck disable=SC2086
+            "$sps" $opts -d : "$cmds" "$file" > /dev/null
+        done
+        # shellcheck disable=SC2086
+        "$sps" $opts -d ':,;' "$cmds" "$dir/text.txt" > /dev/null
+    done
+done
+
+"$sps" -r -d : "[_,2];set x;[_,3];clear;icol" "$dir/mixed.txt" > /dev/null
+"$sps" -i -d : "[1,1];set x" "$dir/numeric.txt"
+"$sps" -a -d : "[_,4];set y" "$dir/numeric.txt"
+"$sps" -b -j 2 -o "$dir" "[1,1];set x" "$dir/tab" "$dir/official"
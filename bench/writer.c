@@ -0,0 +1,118 @@
+/*
+ * @file: bench/writer.c
+ * @brief: Throughput of table_print through the buffered writer compared with
+ *         the original per-character fputc output, both outputs have to be equal
+ *         (including quotes of cells with delimiter and cells longer than the buffer)
+ *
+ * usage: ./bench_writer [ROWS] [COLS] [OUTPUT_DIR]
+ */
+
+#define main sps_main
+#include "../sps.c"
+#undef main
+
+#include "common.h"
+
+/* Original output, one character at a time */
+void table_print_fputc(Table *table, char delim, FILE *dst){
+    for (int i = 0; i < table->size; i++){
+        Row *row = &table->rows[i];
+        for (int j = 0; j < row->size; j++){
+            Cell *cell = &row->cells[j];
+            if (cell->delim){
+                fputc('"', dst);
+            }
+            for (int k = 0; k < cell->size; k++){
+                fputc(cell->text[k], dst);
+            }
+            if (cell->delim){
+                fputc('"', dst);
+            }
+            if (j != row->size-1){
+                fputc(delim, dst);
+            }
+        }
+        if (i != table->size-1){
+            fputc('\n', dst);
+        }
+    } fputc('\n', dst);
+}
+
+/* Table with numbers, words, empty cells and quoted cells, one cell is longer than
+ * output buffer
+ */
+void generate(Table *table, int rows, int cols){
+    const char *words[] = {"alpha", "a:b", "", "gamma", "x y:z"};
+    char text[32];
+    srand(1);
+    for (int i = 0; i < rows; i++){
+        table_append(table);
+        for (int j = 0; j < cols; j++){
+            row_append(&table->arena, &table->rows[i]);
+            Cell *cell = &table->rows[i].cells[j];
+            if (rand() % 2){
+                sprintf(text, "%d.%d", rand() % 100000, rand() % 100);
+            } else {
+                strcpy(text, words[rand() % 5]);
+                cell->delim = strchr(text, ':') != NULL;
+            }
+            cell_append_n(&table->arena, cell, text, strlen(text));
+        }
+    }
+    Cell *cell = &table->rows[rows/2].cells[0];
+    for (int k = 0; k < 3 * WRITE_BLOCK; k++){
+        cell_append(&table->arena, cell, 'a' + k % 26);
+    }
+    cell->delim = true;
+}
+
+int main(int argc, char **argv){
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int cols = argc > 2 ? atoi(argv[2]) : 10;
+    const char *dir = argc > 3 ? argv[3] : "/tmp";
+    char old_path[strlen(dir) + 32], new_path[strlen(dir) + 32];
+    sprintf(old_path, "%s/bench_writer_old", dir);
+    sprintf(new_path, "%s/bench_writer_new", dir);
+
+    Table table;
+    table_init(&table);
+    generate(&table, rows, cols);
+
+    FILE *f = fopen(old_path, "w");
+    if (f == NULL){
+        return 1;
+    }
+    double t0 = now();
+    table_print_fputc(&table, ':', f);
+    fclose(f);
+    double t_old = now() - t0;
+
+    f = fopen(new_path, "w");
+    if (f == NULL){
+        return 1;
+    }
+    Writer w;
+    t0 = now();
+    writer_open(&w, f);
+    table_print(&table, ':', &w);
+    int error = writer_close(&w);
+    fclose(f);
+    double t_new = now() - t0;
+
+    struct stat st;
+    stat(new_path, &st);
+    double mb = st.st_size / 1e6;
+    FILE *fa = fopen(old_path, "rb"), *fb = fopen(new_path, "rb");
+    bool equal = !error && fa != NULL && fb != NULL && files_equal(fa, fb);
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    printf("output: %.1f MB\n", mb);
+    printf("fputc:  %.3f s, %.0f MB/s\n", t_old, mb / t_old);
+    printf("writer: %.3f s, %.0f MB/s\n", t_new, mb / t_new);
+    printf("outputs %s\n", equal ? "equal" : "DIFFER");
+
+    unlink(old_path);
+    unlink(new_path);
+    table_destroy(&table);
+    return !equal;
+}
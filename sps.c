@@ -7,39 +7,273 @@
  *         with table structure based on user inputed commands
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <regex.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPS_X86
+#include <immintrin.h>
+#endif
 
 #define DELIM delims[0]
 #define CMD_MAX 1000
 #define CMD_LEN 1000
 #define CMD_DELIM ";" //string format for strtok
 #define SELECTION_DELIM ',' 
-#define CELL_TEXT table->rows[i].cells[j].text
+#define CELL table->rows[i].cells[j]
 #define TEMPORARY_MAX 10
+#define LOAD_BLOCK (1 << 20) //size of a block read by create_table
+#define LOAD_PARALLEL (1 << 20) //minimal size of input parsed by one loader thread
+#define THREADS_MAX 64 //maximal number of threads of loader and per-cell commands (-t)
+#ifndef CELL_PARALLEL
+#define CELL_PARALLEL (1 << 16) //minimal number of selected cells processed by one thread
+#endif
+#define CELL_BLOCK 4096 //rows of selection summed separately, partial sums are added in order
+#define WRITE_BLOCK (1 << 20) //size of output buffer, longer cells are written directly
+#define JOURNAL_MAGIC "SPSJRNL1" //header of journal with original tail of patched file
+#define JOURNAL_SUFFIX ".sps-journal"
+#define ARENA_BLOCK (1 << 20) //minimal size of a block allocated by arena
+#define ARENA_ALIGN 8
+#define ARENA_CLASSES 64 //freed allocations up to ARENA_CLASSES*ARENA_ALIGN bytes are reused
+#define NUM_BUFFER 64 //numbers longer than this are copied to heap before sscanf
+#define INDEX_MIN 1024 //minimal number of slots of the find index
+#define INDEX_EDITS 64 //row and column edits applied to entries of the find index only when used
+#define SORT_RUN 16 //runs of sort shorter than this are sorted by insertion
+#define SORT_PARALLEL (1 << 15) //minimal number of rows sorted by one thread
+#define SORT_THREADS 16 //maximal number of threads of one sort
+#define GROUP_MIN 1024 //minimal number of slots of group hash table
+#define GROUP_HEAD 16 //keys up to this length are compared without reading the table
+#define PROFILE_NAME 64 //maximal length of profiled phase name (longer are cut)
+
+//States of the numeric value cached in a cell
+#define NUM_UNKNOWN 0
+#define NUM_VALID 1
+#define NUM_INVALID 2
+
+//Character classes used by the table loader (bit flags)
+#define CL_DELIM 1
+#define CL_QUOTE 2
+#define CL_ESC 4
+#define CL_NL 8
+
+#define PROGRAM_MAGIC "SPSPROG4" //header of compiled program stored on disk
+//Header of binary snapshot of a table including the final '\0', bytes 0x89 and '\0' are not
+//expected in text tables and "\r\n" reveals conversion of line ends
+#define SNAPSHOT_MAGIC "\x89SPS3\r\n"
+
+//Results of processing one file
+#define FILE_OK 0
+#define FILE_OPEN_ERROR 1
+#define FILE_CMD_ERROR 2
+#define FILE_WRITE_ERROR 3
+#define FILE_NOT_STREAMED 4 //program is not row-local, file has to be loaded
+#define FILE_OUT_CLASH 5 //batch output (-o) would overwrite the input or output of another file
+
+//Passes of streaming execution
+#define STREAM_SCAN 0 //find the widest row
+#define STREAM_SELECTION 1 //print cells of one selection (debug output)
+#define STREAM_EMPTY 2 //find empty columns of the result
+#define STREAM_PRINT 3 //print the result
+
+//Block of memory owned by an arena
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+//Bump allocator for all cells and rows of one table
+typedef struct {
+    ArenaBlock *head; //block used for new allocations
+    void *last; //last allocation, can be resized in place
+    size_t reserved; //bytes allocated from system
+    size_t used; //bytes in live allocations
+    size_t wasted; //bytes left behind by moved or freed allocations
+    void *free_lists[ARENA_CLASSES]; //freed small allocations by size
+    size_t allocs; //number of allocations (profile)
+    size_t copied; //bytes written into cells and moved by resizing (profile)
+} Arena;
 
 //Structure for cells in rows
+//In mmap mode text may point into the mapped input (view), such text is not owned
+//and not null terminated
 typedef struct {
     int size;
     int cap;
     char *text;
     bool delim;
+    bool view;
+    char num_state; //NUM_UNKNOWN until text of the cell is parsed as a number
+    double num; //cached numeric value, valid if num_state is NUM_VALID
 } Cell;
 
 //Strucure for rows in table
+//In lazy mode (-l) a row may stay unparsed: its line points into the mapped input
+//(or to its record in mapped snapshot) and cells are not created, size is the number 
+//of cells it would have
 typedef struct {
     int size;
-    int cap;
+    int cap; //unparsed row of snapshot: 0 until its record is checked, then 1 or -1 if damaged
     Cell *cells;
+    const char *line; //NULL if the row is parsed
 } Row;
 
+/* Gap in array of rows or cells, elements [0,start) are before it and the rest 
+ * of elements is after it. Runs of insertions and deletions at near positions 
+ * only move the gap by few elements instead of shifting the rest of array.
+ * Closed array has its gap (unused capacity) at the end
+ */
+typedef struct {
+    int start; //index of the first element after the gap
+    int size; //number of unused elements in the gap
+} Gap;
+
+//One column of the table in columnar form, built from cells on demand
+typedef struct {
+    bool valid; //column reflects current content of the table
+    int rows;
+    char *pool; //text of all cells of the column, each followed by '\0'
+    size_t *offs; //offset of each cell in pool, offs[rows] is the end of pool
+    unsigned char *filled; //1 if cell is not empty
+    double *nums; //numeric values of cells, parsed on first use
+    unsigned char *num_ok; //1 if cell contains a number, NULL until parsed
+} Column;
+
+//Columnar representation of the table used by read only commands (-c)
+typedef struct {
+    bool enabled;
+    int size;
+    Column *cols;
+} ColumnStore;
+
+//Position of a cell in the table
+typedef struct {
+    int row;
+    int col;
+} Pos;
+
+//Text of cells and positions of the cells in row-major order
+typedef struct {
+    unsigned long long hash;
+    size_t key; //offset of the text in pool of the index
+    int len; //length of the text
+    int size;
+    int cap; //0 while the only position is stored in one
+    int edits; //number of edits from the log of the index applied to positions
+    Pos one;
+    Pos *pos;
+} IndexEntry;
+
+//Insertion or deletion of rows (columns), which moved positions of cells
+typedef struct {
+    bool cols;
+    int at; //first inserted or deleted row (column)
+    int k; //number of inserted rows (columns), negative for deleted ones
+} IndexEdit;
+
+//Hash index from text of cells to their positions used by [find] (-f)
+typedef struct {
+    bool enabled;
+    bool valid; //index reflects current content of the table
+    size_t size; //number of entries
+    size_t entries_cap;
+    IndexEntry *entries; //entries in order of creation, so they can be walked densely
+    size_t cap; //number of slots, power of two
+    int *slots; //indexes of entries, -1 marks an empty slot
+    char *pool; //texts of all entries, each followed by '\0'
+    size_t pool_size;
+    size_t pool_cap;
+    size_t positions; //number of indexed cells
+    size_t work; //positions moved by updates since the last [find]
+    IndexEdit edits[INDEX_EDITS]; //log of edits, which are not applied to all entries
+    int edits_size;
+} FindIndex;
+
+//Buffered output of tables
+typedef struct {
+    int fd; //descriptor of output, -1 if output goes through file
+    FILE *file; //output without descriptor (memory stream)
+    char *buf;
+    size_t size;
+    bool error; //some write failed, following writes are skipped
+    const char *base; //original content, output equal to its prefix is not written (-a)
+    size_t base_size;
+    size_t pos; //position of output, it is the first changed byte once diverged is set
+    bool diverged;
+} Writer;
+
+//Counters of one profiled phase (load, one command or print)
+typedef struct {
+    char name[PROFILE_NAME];
+    double time; //wall time in seconds
+    long long cells; //cells visited
+    long long allocs; //allocations from arena of the table
+    long long copied; //bytes written into cells and moved by resizing
+} ProfileEntry;
+
+//Profile of one file, counters of running phase are differences from the start values
+typedef struct {
+    int size;
+    int cap;
+    ProfileEntry *entries;
+    double start;
+    long long cells, allocs, copied; //values of counters at the start of running phase
+} Profile;
+
+//Header of binary snapshot of a table, it is followed by row index (rows+1 offsets of row
+//records in data), sizes of rows (4 bytes each, padded to 8 bytes) and data with records
+//A record is checksum of the rest of it, number of cells, ends of cell texts relative
+//to the first text (4 bytes each), delim flags of cells and texts, padded to 4 bytes
+//Numbers are in native byte order
+typedef struct {
+    char magic[8]; //SNAPSHOT_MAGIC
+    unsigned long long rows;
+    unsigned long long cells;
+    unsigned long long data_size;
+    unsigned long long checksum; //of row index and sizes, records have their own
+} SnapshotHeader;
+
+//Running checksum of snapshot, bytes of an incomplete 8-byte word wait in tail
+typedef struct {
+    unsigned long long sum;
+    unsigned char tail[8];
+    int fill;
+} Checksum;
+
 //Table structure
 typedef struct {
     int size;
     int cap;
     Row *rows;
+    Arena arena; //owns cell text and cell arrays
+    ColumnStore columns;
+    FindIndex index;
+    char *map; //mapped input file in mmap mode
+    size_t map_size;
+    bool lazy; //some rows may be unparsed (-l)
+    char delim; //delimiter of unparsed rows
+    bool snapshot; //unparsed rows are records of mapped snapshot
+    bool damaged; //a record of snapshot did not match its checksum, cells are left empty
+    int threads; //threads of commands over big selections (-t)
+    long long visited; //cells visited by commands, counted in bulk (profile)
+    Profile *profile; //NULL if profiling is disabled
 } Table;
 
 //Pack argv and argc into one structure Targs
@@ -48,6 +282,189 @@ typedef struct {
     int argc;
 } Args;
 
+//Program options extracted from argv
+typedef struct {
+    char *delims;
+    char *cmd_seq;
+    char *file;
+    bool mmap; //-m: cells are views into mapped input file
+    bool lazy; //-l: rows are parsed only when a command touches them
+    bool stats; //-s: print allocator statistics to stderr
+    bool columnar; //-c: aggregates and searches run over columnar copy of the table
+    bool find_index; //-f: [find] looks up cells in hash index of the table
+    char *program; //-p FILE: cache of compiled command sequence, NULL if not used
+    bool in_place; //-i: table is written to temporary file, which replaces input file
+    bool patch; //-a: with -i, only bytes after unchanged prefix of input file are rewritten
+    bool batch; //-b: process all files after command sequence (or listed on stdin)
+    int jobs; //-j N: number of batch workers, 0 for number of processors
+    char *out_dir; //-o DIR: batch output of each file goes to DIR, NULL for stdout
+    bool stream; //-r: row-local programs are executed one row at a time
+    int threads; //-t N: threads parsing one big file and running commands over big selections
+    char *snapshot; //-w FILE: result is written as binary snapshot to FILE instead of text output
+    char *profile; //-P DEST: profile of phases goes to DEST ("-" for stderr), NULL if disabled
+    char **files; //input files in batch mode
+    int nfiles;
+} Options;
+
+  /**************************/
+ /*****ARENA FUNCTIONS******/
+/**************************/
+
+/* Set default values to an empty arena */
+void arena_init(Arena *arena){
+    arena->head = NULL;
+    arena->last = NULL;
+    arena->reserved = arena->used = arena->wasted = 0;
+    arena->allocs = arena->copied = 0;
+    for (int i = 0; i < ARENA_CLASSES; i++){
+        arena->free_lists[i] = NULL;
+    }
+}
+
+/* Allocate memory from arena, new block is added if there is not enough space
+ * @param arena: arena struct, NULL allocates from heap
+ * @param size: number of bytes
+ * @return: pointer to allocated memory or NULL
+ */
+void * arena_alloc(Arena *arena, size_t size){
+    if (arena == NULL){
+        return malloc(size);
+    }
+    size = (size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    size_t cls = size / ARENA_ALIGN;
+    arena->allocs++;
+    if (cls < ARENA_CLASSES && arena->free_lists[cls] != NULL){
+        void *ptr = arena->free_lists[cls];
+        memcpy(&arena->free_lists[cls], ptr, sizeof(void *));
+        arena->used += size;
+        arena->wasted -= size;
+        return ptr;
+    }
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size){
+        size_t block_size = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL){
+            return NULL;
+        }
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+        arena->reserved += block_size;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+void arena_free(Arena *arena, void *ptr, size_t size);
+
+/* Resize memory from arena, last allocation is resized in place, 
+ * other allocations are moved and their old space is freed
+ * @param old: memory to resize (can be NULL)
+ * @param old_size: current size of memory
+ * @param new_size: requested size
+ */
+void * arena_realloc(Arena *arena, void *old, size_t old_size, size_t new_size){
+    if (arena == NULL){
+        return realloc(old, new_size);
+    }
+    if (old == NULL){
+        return arena_alloc(arena, new_size);
+    }
+    old_size = (old_size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    size_t aligned = (new_size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    ArenaBlock *block = arena->head;
+    if (old == arena->last && (char *)old + aligned <= block->data + block->size){
+        block->used = (char *)old - block->data + aligned;
+        arena->used = arena->used - old_size + aligned;
+        return old;
+    }
+    void *resized = arena_alloc(arena, new_size);
+    if (resized != NULL){
+        memcpy(resized, old, old_size < new_size ? old_size : new_size);
+        arena->copied += old_size < new_size ? old_size : new_size;
+        arena_free(arena, old, old_size);
+    }
+    return resized;
+}
+
+/* Give memory back to arena, last allocation is rolled back,
+ * small allocations are kept for reuse, bigger are wasted until release
+ * @param ptr: memory to free (can be NULL)
+ * @param size: size of memory
+ */
+void arena_free(Arena *arena, void *ptr, size_t size){
+    if (arena == NULL){
+        free(ptr);
+        return;
+    }
+    if (ptr == NULL){
+        return;
+    }
+    size = (size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    arena->used -= size;
+    if (ptr == arena->last){
+        arena->head->used = (char *)ptr - arena->head->data;
+        arena->last = NULL;
+    } else {
+        arena->wasted += size;
+        size_t cls = size / ARENA_ALIGN;
+        if (cls < ARENA_CLASSES && size >= sizeof(void *)){
+            memcpy(ptr, &arena->free_lists[cls], sizeof(void *));
+            arena->free_lists[cls] = ptr;
+        }
+    }
+}
+
+/* Release all memory of arena at once */
+void arena_release(Arena *arena){
+    ArenaBlock *block = arena->head;
+    while (block != NULL){
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
+
+/* Move all blocks of src arena to dst arena, allocations from src stay valid and
+ * are released with dst, new allocations of dst continue in its current block
+ * @param dst: arena, which takes the memory
+ * @param src: arena left empty
+ */
+void arena_merge(Arena *dst, Arena *src){
+    ArenaBlock *tail = src->head;
+    if (tail != NULL){
+        while (tail->next != NULL){
+            tail = tail->next;
+        }
+        if (dst->head == NULL){
+            dst->head = src->head;
+        } else {
+            tail->next = dst->head->next;
+            dst->head->next = src->head;
+        }
+    }
+    dst->reserved += src->reserved;
+    dst->used += src->used;
+    dst->wasted += src->wasted; //free lists of src are not reused
+    dst->allocs += src->allocs;
+    dst->copied += src->copied;
+    arena_init(src);
+}
+
+/* Print allocator statistics
+ * @param dst: destination file
+ */
+void arena_print_stats(Arena *arena, FILE *dst){
+    fprintf(dst, "arena: reserved %zu B, used %zu B, wasted by moves %zu B\n",
+            arena->reserved, arena->used, arena->wasted);
+}
+
 //Stores POSITIONS not INDEXES of selection
 typedef struct {
     int start_row;
@@ -61,6 +478,102 @@ typedef struct {
     Cell variables[TEMPORARY_MAX];
 } Temporary;
 
+//Operation codes of compiled commands
+typedef enum {
+    OP_NOP, //unknown command, does nothing
+    OP_SELECT, //[r,c] or [r1,c1,r2,c2], end 0 means last row/column
+    OP_SELECT_END, //same as OP_SELECT, but start of selection stays unchanged
+    OP_SELECT_NONE, //selection command which keeps current selection
+    OP_MAX, OP_MIN, OP_FIND,
+    OP_CONTAINS, OP_PREFIX, OP_REGEX, //[contains STR], [prefix STR], [regex RE]
+    OP_SEL_STORE, OP_SEL_LOAD, //[set] and [_]
+    OP_IROW, OP_AROW, OP_DROW, OP_ICOL, OP_ACOL, OP_DCOL, OP_CLEAR,
+    OP_SORT, //sort [asc|desc] [num|lex], par[0] is 1 for desc, par[1] is 1 for num
+    OP_GROUP, //group sum|avg|count COL, par[0] is OP_SUM, OP_AVG or OP_COUNT, par[1] is COL
+    OP_SET, OP_SWAP, OP_SUM, OP_AVG, OP_COUNT, OP_LEN,
+    OP_DEF, OP_USE, OP_INC,
+    OP_SEL_ERROR, OP_CMD_ERROR //invalid commands, reported when they are reached
+} Opcode;
+
+//Pattern of search selection ([find], [contains], [prefix] or [regex])
+typedef struct {
+    Opcode op;
+    const char *str;
+    int len;
+    regex_t re; //compiled str of OP_REGEX
+    char *buf; //terminated copy of cell text for regexec
+    size_t buf_cap;
+} Matcher;
+
+//Sort key of one row
+typedef struct {
+    const char *text; //text of key cell (up to the first '\0')
+    int len;
+    int row; //index of the row in sorted range
+    bool num_ok; //key is a number (numeric sort)
+    double num;
+} SortKey;
+
+//Part of sort done by one thread
+typedef struct {
+    Table *table;
+    int first; //index of the first sorted row in table
+    int col; //index of key column
+    bool desc;
+    bool numeric;
+    SortKey *keys;
+    SortKey *tmp; //merge buffer of the same size as keys
+    int lo, mid, hi; //run [lo,hi) is sorted, or [lo,mid) and [mid,hi) are merged
+} SortJob;
+
+//Rows with the same key cell, slot of group hash table
+typedef struct {
+    char head[GROUP_HEAD]; //beginning of the key
+    const char *key; //text of the key cell in the table, not copied
+    int len; //length of the key, -1 for empty slot
+    int order; //index of the group in order of first rows
+    unsigned long long hash;
+    double sum; //sum of numbers in value cells
+    long count; //number of numbers (sum, avg) or nonempty cells (count) in value cells
+} Group;
+
+//Open addressing hash table of groups, groups are stored directly in slots
+typedef struct {
+    int size;
+    size_t cap; //power of two, at most 3/4 of slots is used
+    Group *slots;
+} GroupTable;
+
+//Part of per-cell command done by one thread, parts start at multiples of CELL_BLOCK rows
+typedef struct {
+    Table *table;
+    Opcode op; //OP_SET rewrites cells, OP_SUM, OP_AVG or OP_COUNT computes partial results
+    Selection sc; //rows of this part and all selected columns
+    int block; //index of the first block of this part
+    char *text; //new text of cells (OP_SET)
+    char *delims;
+    Arena arena; //memory of rewritten cells, merged into arena of the table
+    double *sums; //partial sums of blocks of the whole selection
+    int *counts; //numbers (OP_SUM, OP_AVG) or nonempty cells (OP_COUNT) in blocks
+} CellJob;
+
+//One compiled command
+typedef struct {
+    Opcode op;
+    int par[4]; //selection bounds, [r,c] target or index of variable
+    int str; //offset of string operand in program pool, -1 if there is none
+} Instr;
+
+//Command sequence compiled into array of instructions
+typedef struct {
+    int size;
+    int cap;
+    Instr *code;
+    char *pool; //interned strings separated by '\0'
+    int pool_size;
+    int pool_cap;
+} Program;
+
   /**************************/
  /******CELL FUNCTIONS******/
 /**************************/
@@ -73,17 +586,20 @@ Cell cell_init(){
     new_cell.size = new_cell.cap = 0;
     new_cell.text = NULL;
     new_cell.delim = false;
+    new_cell.view = false;
+    new_cell.num_state = NUM_UNKNOWN;
     return new_cell;
 } 
 
 /*
  * Increase capacity of a cell (expand cell.text)
+ * @param arena: arena of the table, NULL for cells outside of table
  * @param cell: cell struct
  * @param new_cap: new capacity
  */
-void cell_resize(Cell *cell, int new_cap){
+void cell_resize(Arena *arena, Cell *cell, int new_cap){
     void *resized;
-    resized = realloc(cell->text, new_cap * sizeof(char));
+    resized = arena_realloc(arena, cell->text, cell->cap, new_cap * sizeof(char));
     if (resized != NULL){
         cell->text = resized;
         cell->cap = new_cap;
@@ -93,14 +609,60 @@ void cell_resize(Cell *cell, int new_cap){
     }
 }
 
+/* Give a view cell its own buffer, so it can be modified */
+void cell_own(Arena *arena, Cell *cell){
+    if (!cell->view){
+        return;
+    }
+    char *text = arena_alloc(arena, cell->size + 1);
+    if (text != NULL){
+        memcpy(text, cell->text, cell->size);
+        text[cell->size] = '\0';
+        cell->cap = cell->size + 1;
+    } else {
+        cell->size = cell->cap = 0;
+    }
+    cell->text = text;
+    cell->view = false;
+}
+
 /* Append a character to an existing cell. Resize the cell if needed */
-void cell_append(Cell *cell, char c){
-    if (cell->cap == cell->size){
-        cell_resize(cell, cell->cap ? cell->cap * 2 : 1);     
+void cell_append(Arena *arena, Cell *cell, char c){
+    cell_own(arena, cell);
+    cell->num_state = NUM_UNKNOWN;
+    if (cell->cap <= cell->size + 1){
+        cell_resize(arena, cell, cell->cap ? cell->cap * 2 : 2);     
     }
-    if (cell->cap > cell->size){
+    if (cell->cap > cell->size + 1){
         cell->text[cell->size] = c;
         cell->size++;
+        if (arena != NULL){
+            arena->copied++;
+        }
+    }
+}
+
+/* Append n characters to an existing cell at once. Text stays null terminated
+ * @param cell: cell struct
+ * @param str: characters to append
+ * @param n: number of characters
+ */
+void cell_append_n(Arena *arena, Cell *cell, const char *str, int n){
+    cell_own(arena, cell);
+    cell->num_state = NUM_UNKNOWN;
+    if (cell->size + n >= cell->cap){
+        int new_cap = cell->cap ? cell->cap : 1;
+        while (new_cap <= cell->size + n){
+            new_cap *= 2;
+        }
+        cell_resize(arena, cell, new_cap);
+    }
+    if (cell->size + n < cell->cap){
+        memcpy(cell->text + cell->size, str, n);
+        cell->size += n;
+        if (arena != NULL){
+            arena->copied += n;
+        }
     }
 }
 
@@ -122,11 +684,17 @@ bool contains_delim(char *string, char *delims){
  * @param cell: cell struct
  * @param string: string to write to a cell ("\0" clears the cell)
  */
-void cell_rewrite(Cell *cell, char *string, char *delims){
-    cell->size = cell->cap = 0;
-    for (size_t i = 0; i < strlen(string); i++){
-        cell_append(cell, string[i]);
+void cell_rewrite(Arena *arena, Cell *cell, char *string, char *delims){
+    if (cell->view){
+        cell->text = NULL;
+        cell->view = false;
+    }
+    cell->size = 0;
+    if (cell->text != NULL){
+        cell->text[0] = '\0';
     }
+    cell->num_state = NUM_UNKNOWN;
+    cell_append_n(arena, cell, string, strlen(string));
 
     if (contains_delim(string, delims)){
         cell->delim = true;
@@ -141,13 +709,13 @@ void cell_rewrite(Cell *cell, char *string, char *delims){
  */
 void cell_print(Cell *cell, FILE *dst){
     if (cell->delim){
-        putchar('"');
+        fputc('"', dst);
     }
     for (int i = 0; i < cell->size; i++){
         fputc(cell->text[i], dst);
     }
     if (cell->delim){
-        putchar('"');
+        fputc('"', dst);
     }
 }
 
@@ -163,6 +731,11 @@ void get_cell_text(Cell *cell, char *string){
     string[i] = '\0';
 }
 
+/* Check if cell has no text (inserted cells contain only '\0') */
+bool cell_empty(Cell *cell){
+    return cell->size == 0 || cell->text[0] == '\0';
+}
+
 /* Swap 2 whole cells at any positions in a table
  * @param table: table struct
  * @param src_row, src_col: row and column indexes of one cell
@@ -175,947 +748,5342 @@ void cell_swap(Table *table, int src_row, int src_col, int dst_row, int dst_col)
     table->rows[dst_row].cells[dst_col] = tmp;
 }
 
-/* Destroy instantance of a cell and set its size/capacity to default value */
-void cell_destroy(Cell *cell){
-    free(cell->text);
-    cell->cap = cell->size = 0;
-    
-}
+//Powers of ten, which are exactly representable as double
+const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-/* Remove cell at a given position in a row
- * @param row: row struct
- * @param index: index of a cell to remove
+/* Convert number with sscanf, used for numbers the fast path can not convert exactly
+ * @see: parse_double
  */
-void cell_delete(Row *row, int index){
-        cell_destroy(&row->cells[index]);
-        for (int i = index+1; i < row->size; i++){
-            memcpy(&row->cells[i-1], &row->cells[i], sizeof(Cell));
-        }
-        row->size--;
-}
-
-  /*****************************/
- /*******ROW FUNCTIONS*********/
-/*****************************/
+int parse_double_slow(const char *str, int len, double *num){
+    char buffer[NUM_BUFFER];
+    char *copy = len < NUM_BUFFER ? buffer : malloc(len+1);
+    if (copy == NULL){
+        return 1;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
 
-/* Initialize a new row with default values
- * @return: empty initialized row
- */
-Row row_init(){
-    Row new_row;
-    new_row.size = new_row.cap = 0;
-    new_row.cells = NULL;
-    return new_row;
+    double temp;
+    int result = 1;
+    if (copy[0] != '\0' && sscanf(copy, "%lf", &temp) == 1){
+        *num = temp;
+        result = 0;
+    }
+    if (copy != buffer){
+        free(copy);
+    }
+    return result;
 }
 
-/* Make space for new cells in a row 
- * @param row: row struct
- * @param cells_n: new maximal ammount of cells
- * @see: cell_resize
+/* Convert beginning of text to double with the same result as sscanf("%lf")
+ * Decimal numbers with at most 19 significant digits, which mantissa and power of ten
+ * are exact doubles, are converted directly. Others (hexadecimal, inf, nan, long or 
+ * huge numbers) are left to sscanf
+ * @param str: text to convert (does not need to be null terminated)
+ * @param len: length of text
+ * @param num: store converted number here
+ * @return: 0 if text starts with a number, otherwise return 1
  */
-void row_resize(Row *row, int cells_n){
-    void *resized;
-    resized = realloc(row->cells, cells_n * sizeof(Cell));
+int parse_double(const char *str, int len, double *num){
+    int i = 0;
+    while (i < len && isspace((unsigned char)str[i])){
+        i++;
+    }
+    bool negative = false;
+    if (i < len && (str[i] == '-' || str[i] == '+')){
+        negative = str[i] == '-';
+        i++;
+    }
 
-    if (resized != NULL){
-        row->cells = resized;
-        row->cap = cells_n;
+    unsigned long long mantissa = 0;
+    int digits = 0, scale = 0;
+    bool any = false, point = false;
+    for (; i < len; i++){
+        if (str[i] == '.' && !point){
+            point = true;
+            continue;
+        }
+        if (!isdigit((unsigned char)str[i])){
+            break;
+        }
+        any = true;
+        if (mantissa == 0 && str[i] == '0'){ //leading zeros are not significant
+            scale -= point;
+            continue;
+        }
+        if (digits == 19){
+            return parse_double_slow(str, len, num);
+        }
+        mantissa = mantissa * 10 + (str[i] - '0');
+        digits++;
+        scale -= point;
+    }
+    if (!any || (i < len && (str[i] == 'x' || str[i] == 'X'))){
+        return parse_double_slow(str, len, num);
     }
-}
 
-/* Append new empty cell to a row. Resize the row if needed */
-void row_append(Row *row){
-    if (row->size+1 > row->cap){
-        row_resize(row, row->cap + 1);
+    if (i+1 < len && (str[i] == 'e' || str[i] == 'E')){
+        int j = i+1, exponent = 0;
+        bool exp_negative = false;
+        if (str[j] == '-' || str[j] == '+'){
+            exp_negative = str[j] == '-';
+            j++;
+        }
+        if (j < len && isdigit((unsigned char)str[j])){
+            for (; j < len && isdigit((unsigned char)str[j]); j++){
+                if (exponent < 10000){
+                    exponent = exponent * 10 + (str[j] - '0');
+                }
+            }
+            scale += exp_negative ? -exponent : exponent;
+        }
     }
-    if (row->size+1 <= row->cap){
-        row->cells[row->size] = cell_init();
-        row->size++;
+
+    double value;
+    if (mantissa == 0){
+        value = 0.0;
+    } else if (mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22){
+        value = (double)mantissa;
+        value = scale < 0 ? value / exact_pow10[-scale] : value * exact_pow10[scale];
+    } else {
+        return parse_double_slow(str, len, num);
     }
+    *num = negative ? -value : value;
+    return 0;
 }
 
-/* Insert a new empty cell with default values (text = "\0")
- * @param row: row struct
- * @param index: identifies where to insert the new cell
+/* Convert number from string format do double
+ * @param string: string to convert
+ * @param num: store string into this number
+ * @return: 0 if number was successfully extracted from string, otherwise return 1
  */
-void row_insert(Row *row, int index){
-    Cell new_cell = cell_init();
-    cell_append(&new_cell, '\0');
-    row_append(row);
-    
-    int i;
-    for (i = row->size-1; i != index; i--){ 
-        //move all cells to the right by one
-        memcpy(&row->cells[i], &row->cells[i-1], sizeof(Cell));
+int string_to_double(char *string, double *num){
+    if (string != NULL && strcmp(string,"")){
+        return parse_double(string, strlen(string), num);
     }
-    row->cells[i] = new_cell;
+    return 1;
 }
 
-/* @see: cell_print
- * @param delim: delim to separate the cells
- * @param dst: destination file
+/* Convert text of a cell to double, result is cached in the cell until its text changes
+ * @see: string_to_double
  */
-void row_print(Row *row, char delim, FILE *dst){
-    for (int i = 0; i < row->size; i++){
-        cell_print(&row->cells[i], dst);
-        //put delimiter after each cell
-        if (i != row->size-1){
-            fputc(delim, dst);
+int cell_to_double(Cell *cell, double *num){
+    if (cell->num_state == NUM_UNKNOWN){
+        if (cell->size && cell->text[0] != '\0' && !parse_double(cell->text, cell->size, &cell->num)){
+            cell->num_state = NUM_VALID;
+        } else {
+            cell->num_state = NUM_INVALID;
         }
     }
+    if (cell->num_state == NUM_VALID){
+        *num = cell->num;
+        return 0;
+    }
+    return 1;
 }
 
-/* Destroy all instances of cells in a row */ 
-void row_destroy(Row *row){
-    for (int i = 0; i < row->size; i++){
-        cell_destroy(&row->cells[i]);
+/* Destroy instantance of a cell and set its size/capacity to default value */
+void cell_destroy(Arena *arena, Cell *cell){
+    if (!cell->view){
+        arena_free(arena, cell->text, cell->cap);
     }
-
-    if (row->cap)
-        free(row->cells);
+    cell->text = NULL;
+    cell->view = false;
+    cell->cap = cell->size = 0;
+    
 }
 
-/* Delete row at given position
- * @param table: table struct
- * @param index: index of row to delete
+/* Remove cell at a given position in a row
+ * @param row: row struct
+ * @param index: index of a cell to remove
  */
-void row_delete(Table *table, int index){
-    row_destroy(&table->rows[index]);
-    for (int i = index+1; i < table->size; i++){
-        memcpy(&table->rows[i-1], &table->rows[i], sizeof(Row));
-    }
-    table->size--;
+void cell_delete(Arena *arena, Row *row, int index){
+        cell_destroy(arena, &row->cells[index]);
+        memmove(&row->cells[index], &row->cells[index+1], (row->size-index-1) * sizeof(Cell));
+        row->size--;
 }
 
   /*****************************/
- /*******TABLE FUNCTIONS*******/
+ /******KERNEL FUNCTIONS*******/
 /*****************************/
 
-/* Set default values to an empty table */
-void table_init(Table *table){
-    table->size = 0;
-    table->cap = 0;
-    table->rows = NULL;
+//Reductions over arrays of values, implemented for every instruction set
+typedef struct {
+    const char *name;
+    //number of nonzero flags
+    int (*count)(const unsigned char *flags, int n);
+    //index of first maximal (max) or minimal value with nonzero ok flag, -1 if there is none
+    int (*arg_extreme)(const double *vals, const unsigned char *ok, int n, bool max);
+} Kernels;
+
+int count_scalar(const unsigned char *flags, int n){
+    int counter = 0;
+    for (int i = 0; i < n; i++){
+        counter += flags[i] != 0;
+    }
+    return counter;
 }
 
-/* Make space for new rows in the table
- * @param table: pointer to a table
- * @param rows_n: new maximal ammount of rows
- * @see: cell_resize
+int arg_extreme_scalar(const double *vals, const unsigned char *ok, int n, bool max){
+    int index = -1;
+    for (int i = 0; i < n; i++){
+        if (!ok[i]){
+            continue;
+        }
+        if (index < 0 || (max ? vals[i] > vals[index] : vals[i] < vals[index])){
+            index = i;
+        }
+    }
+    return index;
+}
+
+/* Sum of values with nonzero ok flag, added in order of the array
+ * Addition is kept sequential on every instruction set, so the result is bit for bit
+ * equal to adding values one by one
  */
-void table_resize(Table *table, int rows_n){
-    void *resized;
-    resized = realloc(table->rows, rows_n * sizeof(Row));
+double sum_ordered(const double *vals, const unsigned char *ok, int n, int *counter){
+    double sum = 0;
+    int valid = 0;
+    for (int i = 0; i < n; i++){
+        if (ok[i]){
+            sum += vals[i];
+            valid++;
+        }
+    }
+    *counter = valid;
+    return sum;
+}
 
-    if (resized != NULL){
-        table->rows = resized;
-        table->cap = rows_n;
+/* Sum of valid values in blocks of given length, sums of blocks are added in order
+ * @param block: number of values in one block
+ * @see: sum_ordered, cells_reduce
+ */
+double sum_blocks(const double *vals, const unsigned char *ok, int n, int block, int *counter){
+    double sum = 0;
+    *counter = 0;
+    for (int k = 0; k < n; k += block){
+        int valid;
+        sum += sum_ordered(vals + k, ok + k, n - k < block ? n - k : block, &valid);
+        *counter += valid;
     }
+    return sum;
 }
 
-/* Create a new row with default values at the end of the table */
-void table_append(Table *table){
-    if (table->cap == table->size){
-        table_resize(table, table->size+1);
+#ifdef SPS_X86
+__attribute__((target("sse2")))
+int count_sse2(const unsigned char *flags, int n){
+    __m128i zero = _mm_setzero_si128(), total = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16){
+        __m128i v = _mm_loadu_si128((const __m128i *)(flags + i));
+        v = _mm_sub_epi8(zero, _mm_cmpeq_epi8(v, zero)); //1 for zero flags
+        total = _mm_add_epi64(total, _mm_sad_epu8(v, zero));
     }
-    if (table->size < table->cap){
-        table->rows[table->size] = row_init();
-        table->size++;
+    long long zeros[2];
+    _mm_storeu_si128((__m128i *)zeros, total);
+    return (i - (int)(zeros[0] + zeros[1])) + count_scalar(flags + i, n - i);
+}
+
+__attribute__((target("avx2")))
+int count_avx2(const unsigned char *flags, int n){
+    __m256i zero = _mm256_setzero_si256(), total = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= n; i += 32){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(flags + i));
+        v = _mm256_sub_epi8(zero, _mm256_cmpeq_epi8(v, zero));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(v, zero));
     }
+    long long zeros[4];
+    _mm256_storeu_si256((__m256i *)zeros, total);
+    return (i - (int)(zeros[0] + zeros[1] + zeros[2] + zeros[3])) + 
+           count_scalar(flags + i, n - i);
 }
 
-/* Insert a new row with same number of initialized cells as the other rows 
- * @param table: table struct
- * @param index: index in table, where new row is created
+/* First pass finds the extreme value, second pass its first position.
+ * Comparisons with NaN are not ordered, arrays with valid NaN use the scalar kernel
  */
-void table_insert(Table *table, int index){
-    Row new_row = row_init();
-    for (int i = 0; i < table->rows->size; i++){
-        row_append(&new_row);
-        cell_append(&new_row.cells[i], '\0');
+__attribute__((target("sse2")))
+int arg_extreme_sse2(const double *vals, const unsigned char *ok, int n, bool max){
+    __m128d fill = _mm_set1_pd(max ? -HUGE_VAL : HUGE_VAL), acc = fill;
+    __m128d nan = _mm_setzero_pd();
+    int valid = 0, i = 0;
+    for (; i + 2 <= n; i += 2){
+        __m128d mask = _mm_castsi128_pd(_mm_set_epi64x(-(long long)(ok[i+1] != 0), 
+                                                        -(long long)(ok[i] != 0)));
+        __m128d v = _mm_loadu_pd(vals + i);
+        nan = _mm_or_pd(nan, _mm_and_pd(mask, _mm_cmpunord_pd(v, v)));
+        v = _mm_or_pd(_mm_and_pd(mask, v), _mm_andnot_pd(mask, fill));
+        acc = max ? _mm_max_pd(acc, v) : _mm_min_pd(acc, v);
+        valid |= _mm_movemask_pd(mask);
     }
-    table_append(table);
-    int i;
-    for (i = table->size-1; i != index; i--){
-        //move all rows by 1 to the right
-        memcpy(&table->rows[i], &table->rows[i-1], sizeof(Row));
+    if (_mm_movemask_pd(nan)){
+        return arg_extreme_scalar(vals, ok, n, max);
     }
-    table->rows[index] = new_row;
-}
-
-/* Get length of the longest row
- * @return: maximal row size in a table
- */
-int get_max_row(Table table){
-    int max_row = 0;
-    
-    for (int i = 0; i < table.size; i++){
-        if (table.rows[i].size > max_row){
-            max_row = table.rows[i].size;        
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double extreme = max ? (lanes[0] > lanes[1] ? lanes[0] : lanes[1]) 
+                         : (lanes[0] < lanes[1] ? lanes[0] : lanes[1]);
+    for (; i < n; i++){ //tail
+        if (!ok[i]){
+            continue;
         }
+        if (vals[i] != vals[i]){
+            return arg_extreme_scalar(vals, ok, n, max);
+        }
+        if (!valid || (max ? vals[i] > extreme : vals[i] < extreme)){
+            extreme = vals[i];
+        }
+        valid = 1;
     }
-    return max_row;
+    if (!valid){
+        return -1;
+    }
+    __m128d target = _mm_set1_pd(extreme);
+    for (i = 0; i + 2 <= n; i += 2){
+        int hits = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(vals + i), target));
+        if ((hits & 1) && ok[i])
+            return i;
+        if ((hits & 2) && ok[i+1])
+            return i+1;
+    }
+    for (; i < n; i++){
+        if (ok[i] && vals[i] == extreme)
+            return i;
+    }
+    return -1;
 }
 
-/* Fill the table with empty cells so each row has equal ammount of cells */
-void fill_table(Table *table){
-    int max_row = get_max_row(*table);
-    
-    for (int i = 0; i < table->size; i++){
-        while (table->rows[i].size != max_row){
-            row_append(&table->rows[i]);
+__attribute__((target("avx2")))
+int arg_extreme_avx2(const double *vals, const unsigned char *ok, int n, bool max){
+    __m256d fill = _mm256_set1_pd(max ? -HUGE_VAL : HUGE_VAL), acc = fill;
+    __m256d nan = _mm256_setzero_pd();
+    int valid = 0, i = 0;
+    for (; i + 4 <= n; i += 4){
+        int flags;
+        memcpy(&flags, ok + i, sizeof(int));
+        __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+        __m256d mask = _mm256_castsi256_pd(_mm256_cmpgt_epi64(wide, _mm256_setzero_si256()));
+        __m256d v = _mm256_loadu_pd(vals + i);
+        nan = _mm256_or_pd(nan, _mm256_and_pd(mask, _mm256_cmp_pd(v, v, _CMP_UNORD_Q)));
+        v = _mm256_blendv_pd(fill, v, mask);
+        acc = max ? _mm256_max_pd(acc, v) : _mm256_min_pd(acc, v);
+        valid |= _mm256_movemask_pd(mask);
+    }
+    if (_mm256_movemask_pd(nan)){
+        return arg_extreme_scalar(vals, ok, n, max);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double extreme = lanes[0];
+    for (int l = 1; l < 4; l++){
+        if (max ? lanes[l] > extreme : lanes[l] < extreme)
+            extreme = lanes[l];
+    }
+    for (int j = i; j < n; j++){ //tail
+        if (!ok[j]){
+            continue;
         }
-    }  
-}
-
-/* @see: cell_print
- * @param delim: delimiter of cells in the table
- * @param dst: destination file (stdout for testing purposes)
- */
-void table_print(Table *table,  char delim, FILE *dst){
-    for (int i = 0; i < table->size; i++){
-        row_print(&table->rows[i], delim, dst);
-        if (i != table->size-1){
-            fputc('\n', dst);
+        if (vals[j] != vals[j]){
+            return arg_extreme_scalar(vals, ok, n, max);
         }
-    } fputc('\n', dst);
-}
-
-/* Destroy all instances of rows in a table */
-void table_destroy(Table *table){
-    for (int i = 0; i < table->size; i++){
-        row_destroy(&table->rows[i]);
+        if (!valid || (max ? vals[j] > extreme : vals[j] < extreme)){
+            extreme = vals[j];
+        }
+        valid = 1;
     }
-
-    if (table->cap){
-        free(table->rows);
+    if (!valid){
+        return -1;
+    }
+    __m256d target = _mm256_set1_pd(extreme);
+    for (i = 0; i + 4 <= n; i += 4){
+        int hits = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(vals + i), target, _CMP_EQ_OQ));
+        for (int l = 0; hits; l++, hits >>= 1){
+            if ((hits & 1) && ok[i+l])
+                return i+l;
+        }
+    }
+    for (; i < n; i++){
+        if (ok[i] && vals[i] == extreme)
+            return i;
     }
+    return -1;
 }
+#endif
 
-/* Add more rows or columns if the selection is bigger than the table
- * @param table: pointer to a table structure
- * @param new_rows: expected number of rows in updated table
- * @param new_cols: expected number of columns in updated table
+const Kernels kernels_scalar = {"scalar", count_scalar, arg_extreme_scalar};
+#ifdef SPS_X86
+const Kernels kernels_sse2 = {"sse2", count_sse2, arg_extreme_sse2};
+const Kernels kernels_avx2 = {"avx2", count_avx2, arg_extreme_avx2};
+#endif
+
+/* Choose the best kernels supported by the processor 
+ * @return: pointer to selected kernels
  */
-void table_expand(Table *table, int new_rows, int new_cols){
-    for (int i = table->size; i < new_rows; i++){
-        table_append(table);
-        fill_table(table);
+const Kernels * kernels_get(){
+#ifdef SPS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")){
+        return &kernels_avx2;
     }
-
-    for (int i = 0; i < table->size; i++){
-        for (int j = table->rows[i].size; j < new_cols; j++){
-            row_append(&table->rows[i]);
-        }
+    if (__builtin_cpu_supports("sse2")){
+        return &kernels_sse2;
     }
-} 
+#endif
+    return &kernels_scalar;
+}
 
-/* Initialize temporary variables with default cells */
-void variables_init(Temporary *tmp_vars){
-    for (int i = 0; i < TEMPORARY_MAX; i++){
-        tmp_vars->variables[i] = cell_init();
-    }  
+  /*****************************/
+ /******COLUMN FUNCTIONS*******/
+/*****************************/
+
+/* Set default values to an empty column store */
+void columns_init(ColumnStore *store){
+    store->enabled = false;
+    store->size = 0;
+    store->cols = NULL;
 }
 
-/* Destroy all instances of temporary variables */
-void variables_destroy(Temporary *tmp_vars){
-    for (int i = 0; i < TEMPORARY_MAX; i++){
-        cell_destroy(&tmp_vars->variables[i]);
+/* Free data of one column and mark it as invalid */
+void column_clear(Column *col){
+    free(col->pool);
+    free(col->offs);
+    free(col->filled);
+    free(col->nums);
+    free(col->num_ok);
+    col->pool = NULL;
+    col->offs = NULL;
+    col->filled = NULL;
+    col->nums = NULL;
+    col->num_ok = NULL;
+    col->rows = 0;
+    col->valid = false;
+}
+
+/* Destroy all columns of the store */
+void columns_destroy(ColumnStore *store){
+    for (int i = 0; i < store->size; i++){
+        column_clear(&store->cols[i]);
     }
+    free(store->cols);
+    store->cols = NULL;
+    store->size = 0;
 }
 
-/* Checks if char is a delim
- * @param c: character to check
- * @param delims: delimiters
- * @return: true if successful, false if unsuccessful
+/* Mark columns as outdated after the table was modified
+ * @param start_col, end_col: indexes of modified columns, -1 for all columns
  */
-bool isdelim(char c, char *delims){
-    for (size_t i = 0; i < strlen(delims); i++){
-        if (c == delims[i]) {
-            return true;
-        }
+void table_changed(Table *table, int start_col, int end_col){
+    ColumnStore *store = &table->columns;
+    if (start_col < 0 || end_col >= store->size){
+        end_col = store->size-1;
+    }
+    if (start_col < 0){
+        start_col = 0;
+    }
+    for (int j = start_col; j <= end_col; j++){
+        store->cols[j].valid = false;
     }
-    return false;
 }
 
-/* Take input from a file and insert it into table using cell,row,table structures
- * @param table: table struct
- * @param source: source file
- * @param delims: delimiters from argv
+/* Make space for cols_n columns in the store
+ * Pointers to columns are valid until the store is resized
+ * @return: 0 if successful, 1 if memory could not be allocated
  */
-void create_table(Table *table, FILE *source, char *delims){
-    int c, current_cell = 0, current_row = 0;
-    int quotes_active = -1; //changing sign to + or - depending whether quotes are active
+int columns_reserve(ColumnStore *store, int cols_n){
+    if (cols_n <= store->size){
+        return 0;
+    }
+    Column *resized = realloc(store->cols, cols_n * sizeof(Column));
+    if (resized == NULL){
+        return 1;
+    }
+    store->cols = resized;
+    for (int j = store->size; j < cols_n; j++){
+        store->cols[j].pool = NULL;
+        store->cols[j].offs = NULL;
+        store->cols[j].filled = NULL;
+        store->cols[j].nums = NULL;
+        store->cols[j].num_ok = NULL;
+        column_clear(&store->cols[j]);
+    }
+    store->size = cols_n;
+    return 0;
+}
 
-    while ((c = fgetc(source)) != EOF){
-        if (table->rows == NULL){
-            table_append(table); 
-        }
-        if (table->rows[current_row].cells == NULL){
-            row_append(&table->rows[current_row]);
-        }
+void table_parse(Table *table, int start_row, int end_row);
 
-        if (c == '\n'){ 
-            current_cell = 0;
-            current_row++;
-            table_append(table); 
-            continue;
-        } 
-        else if (c == '"'){
-            quotes_active *= -1;
+/* Get a column of the table, build it from cells if it is outdated
+ * @param index: index of column
+ * @return: pointer to column or NULL if it can not be built
+ */
+Column * column_get(Table *table, int index){
+    ColumnStore *store = &table->columns;
+    int cols_n = table->size ? table->rows[0].size : 0;
+    if (columns_reserve(store, index >= cols_n ? index+1 : cols_n)){
+        return NULL;
+    }
 
-        } 
-        else if (c == '\\'){           
-            if ((c = fgetc(source)) != EOF){
-                if (isdelim(c, delims)){
-                    table->rows[current_row].cells[current_cell].delim = true;
-                }
-                cell_append(&table->rows[current_row].cells[current_cell], c);
-                continue;
-            }
-        }
+    Column *col = &store->cols[index];
+    if (col->valid){
+        return col;
+    }
+    column_clear(col);
+    table_parse(table, 1, table->size);
 
-        if (isdelim(c, delims) && quotes_active == -1){
-            current_cell++;
-            row_append(&table->rows[current_row]);
-            continue;
-        }
-    
-        if (isdelim(c, delims)){
-            table->rows[current_row].cells[current_cell].delim = true;
-            }
+    size_t len = 0;
+    for (int i = 0; i < table->size; i++){
+        len += table->rows[i].cells[index].size + 1;
+    }
+    col->pool = malloc(len ? len : 1);
+    col->offs = malloc((table->size+1) * sizeof(size_t));
+    col->filled = malloc(table->size ? table->size : 1);
+    if (col->pool == NULL || col->offs == NULL || col->filled == NULL){
+        column_clear(col);
+        return NULL;
+    }
 
-        if (c != '"'){
-            cell_append(&table->rows[current_row].cells[current_cell], c);
+    size_t pos = 0;
+    for (int i = 0; i < table->size; i++){
+        Cell *cell = &table->rows[i].cells[index];
+        col->offs[i] = pos;
+        col->filled[i] = !cell_empty(cell);
+        if (cell->size){
+            memcpy(col->pool + pos, cell->text, cell->size);
         }
+        pos += cell->size;
+        col->pool[pos++] = '\0';
     }
-
-    //delete last row, because of \n from last line in file
-    row_destroy(&table->rows[table->size]-1);
-    table->size--;
+    col->offs[table->size] = pos;
+    col->rows = table->size;
+    col->valid = true;
+    return col;
 }
 
-/* Locate delim in program arguments 
- * @return: string with space or string of delimiters
+/* Parse numbers of a column if they were not parsed yet
+ * @return: 0 if successful, 1 if memory could not be allocated
  */
-char * find_delim(const Args args){
-    char *delim = " ";
-    if (!strcmp(args.argv[1], "-d")){
-        delim = args.argv[2];
-    } 
-    return delim;
+int column_parse(Column *col){
+    if (col->num_ok != NULL){
+        return 0;
+    }
+    col->nums = malloc((col->rows ? col->rows : 1) * sizeof(double));
+    col->num_ok = malloc(col->rows ? col->rows : 1);
+    if (col->nums == NULL || col->num_ok == NULL){
+        free(col->nums);
+        free(col->num_ok);
+        col->nums = NULL;
+        col->num_ok = NULL;
+        return 1;
+    }
+    for (int i = 0; i < col->rows; i++){
+        col->nums[i] = 0;
+        col->num_ok[i] = !string_to_double(col->pool + col->offs[i], &col->nums[i]);
+    }
+    return 0;
 }
 
+  /*****************************/
+ /*******INDEX FUNCTIONS*******/
+/*****************************/
 
-
-/* Temporary function for selection to print out selected cells */
-void print_selection(Selection *sc, Table *table){  
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            cell_print(&table->rows[i].cells[j], stdout);
-            putchar(' ');
-        }
-    }  
+/* Set default values to an empty index */
+void index_init(FindIndex *index){
+    index->enabled = false;
+    index->valid = false;
+    index->size = index->entries_cap = index->cap = 0;
+    index->entries = NULL;
+    index->slots = NULL;
+    index->pool = NULL;
+    index->pool_size = index->pool_cap = 0;
+    index->positions = index->work = 0;
+    index->edits_size = 0;
 }
 
-/* Resizing the table if new selection bigger than the table size */
-void check_table_size(Selection *sc, Table *table){
-    if (sc->end_row > table->size){
-        table_expand(table, sc->end_row, 0);
-    } 
-    if (sc->end_col > get_max_row(*table)){
-        table_expand(table, 0, sc->end_col);
+/* Free all entries of the index and mark it as invalid, it is rebuilt by next [find] */
+void index_clear(FindIndex *index){
+    for (size_t i = 0; i < index->size; i++){
+        if (index->entries[i].cap){
+            free(index->entries[i].pos);
+        }
     }
+    free(index->entries);
+    free(index->slots);
+    free(index->pool);
+    bool enabled = index->enabled;
+    index_init(index);
+    index->enabled = enabled;
 }
 
-/* Return index of n-th character in a string
- * @param c: string: character to find in string
- * @param n: occurance of number in a string
- * @return: index of found character or 0 if no character was found 
+/* Text of a cell as compared by [find], it ends at the first '\0' 
+ * @param len: length of the text
+ * @return: pointer to the text (not terminated)
  */
-int char_index(char c, char *string, int n){
-    int counter = 0;
-    for (int i = 0; string[i] != '\0'; i++){
-        if (string[i] == c){
-            counter++;
-            if (counter == n){
-                return i;
-            }
-        }
+const char * cell_key(Cell *cell, int *len){
+    if (cell->text == NULL || cell->size == 0){
+        *len = 0;
+        return "";
     }
-    return 0;
+    const char *end = memchr(cell->text, '\0', cell->size);
+    *len = end ? end - cell->text : cell->size;
+    return cell->text;
 }
 
-/* Returns number of characters in a string */
-int char_in_string(char c, char *string){
-    int counter = 0;
-    char *temp = strchr(string,c);
-    while (temp != NULL){
-        counter++;
-        temp = strchr(temp+1, c);
+/* FNV-1a hash of a text */
+unsigned long long index_hash(const char *text, int len){
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < len; i++){
+        hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
     }
-    return counter;
+    return hash;
 }
 
-/* Convert number from string format do double
- * @param string: string to convert
- * @param num: store string into this number
- * @return: 0 if number was successfully extracted from string, otherwise return 1
+/* Resize slots of the index, entries are put to their new slots by stored hashes
+ * @param cap: new number of slots, power of two
+ * @return: 0 if successful, 1 if memory could not be allocated
  */
-int string_to_double(char *string, double *num){
-    double temp;
-    if (string != NULL && strcmp(string,"")){
-        if (sscanf(string, "%lf", &temp)){
-            *num = temp;
-            return 0;
-        } else {
-            return 1;
+int index_resize(FindIndex *index, size_t cap){
+    int *slots = malloc(cap * sizeof(int));
+    if (slots == NULL){
+        return 1;
+    }
+    for (size_t i = 0; i < cap; i++){
+        slots[i] = -1;
+    }
+    for (size_t i = 0; i < index->size; i++){
+        size_t k = index->entries[i].hash & (cap-1);
+        while (slots[k] >= 0){
+            k = (k+1) & (cap-1);
         }
+        slots[k] = i;
     }
-    return 1;
+    free(index->slots);
+    index->slots = slots;
+    index->cap = cap;
+    return 0;
 }
 
-/* Find first refference value in a table and store it 
- * Refference value serves as first valid value to compare other values with
- * @return: 0 if valid value was found, 1 if no valid value was found
- */
-int find_refference(Selection *sc, Table *table, double *reff, int *r_index, int *c_index){
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            if (!string_to_double(table->rows[i].cells[j].text, reff)){
-                *r_index = i;
-                *c_index = j;
-                return 0;
-            }
-        }
-    }
-    return 1;
+/* Positions of an entry, sorted in row-major order */
+Pos * entry_positions(IndexEntry *entry){
+    return entry->cap ? entry->pos : &entry->one;
 }
 
-/* Max/Min selection specifier - function to find minimal or maximal numeric value in selection
- * @param sc: selection struct
- * @param table: table struct
- * @param str: can be "min" or "max"
+/* Apply edits from the log of the index, which are not applied to the entry yet,
+ * order of positions stays the same, positions of deleted cells are removed
  */
-void m_selection(Selection *sc, Table *table, char *str){
-    double reff; 
-    double content;
-    int r_index = 1, c_index = 1;
-    if (find_refference(sc, table, &reff, &r_index, &c_index))
+void entry_sync(FindIndex *index, IndexEntry *entry){
+    if (entry->edits == index->edits_size){
         return;
-    
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            if (string_to_double(table->rows[i].cells[j].text, &content)){
-                continue;
+    }
+    Pos *pos = entry_positions(entry);
+    int n = 0;
+    for (int j = 0; j < entry->size; j++){
+        Pos p = pos[j];
+        int e = entry->edits;
+        for (; e < index->edits_size; e++){
+            IndexEdit *edit = &index->edits[e];
+            int *c = edit->cols ? &p.col : &p.row;
+            if (*c >= edit->at && *c < edit->at - edit->k){ //deleted cell
+                break;
             }
-            if (!strcmp(str, "max")){
-                if (content > reff){
-                    reff = content;
-                    r_index = i;
-                    c_index = j;
-                }
-            } else {
-                if (content < reff){
-                    reff = content;
-                    r_index = i;
-                    c_index = j;
-                }
+            if (*c >= edit->at){
+                *c += edit->k;
             }
         }
+        if (e == index->edits_size){
+            pos[n++] = p;
+        }
     }
-    sc->start_row = sc->end_row = r_index+1;
-    sc->start_col = sc->end_col = c_index+1;
+    index->positions -= entry->size - n;
+    index->work += entry->size;
+    entry->size = n;
+    entry->edits = index->edits_size;
 }
 
-/* Find first occurance of string in a table
- * @param sc: selection struct
- * @param table: table struct
- * @param string: string to find in table
+/* Find entry of a text, open addressing with linear probing
+ * @param create: add an entry without positions if the text is not in the index
+ * @return: entry of the text, NULL if it is not found or could not be created
  */
-void find_selection(Selection *sc, Table *table, char *string){
-    string[strlen(string)-1] = '\0'; //remove ] from the end
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            char temp[table->rows[i].cells[j].size+1];
-            get_cell_text(&table->rows[i].cells[j], temp); 
-            if (!strcmp(temp, string)){
-                sc->start_row = sc->end_row = i+1;
-                sc->start_col = sc->end_col = j+1;
-                return;
-            }
+IndexEntry * index_entry(FindIndex *index, const char *text, int len, bool create){
+    if (create && (index->size+1) * 2 > index->cap){
+        if (index_resize(index, index->cap ? index->cap * 2 : INDEX_MIN)){
+            return NULL;
         }
     }
+    if (create && index->size == index->entries_cap){
+        size_t cap = index->entries_cap ? index->entries_cap * 2 : INDEX_MIN;
+        IndexEntry *entries = realloc(index->entries, cap * sizeof(IndexEntry));
+        if (entries == NULL){
+            return NULL;
+        }
+        index->entries = entries;
+        index->entries_cap = cap;
+    }
+    if (index->cap == 0){
+        return NULL;
+    }
+    unsigned long long hash = index_hash(text, len);
+    size_t k = hash & (index->cap-1);
+    for (; index->slots[k] >= 0; k = (k+1) & (index->cap-1)){
+        IndexEntry *entry = &index->entries[index->slots[k]];
+        if (entry->hash == hash && entry->len == len && 
+            !memcmp(index->pool + entry->key, text, len)){
+            entry_sync(index, entry);
+            return entry;
+        }
+    }
+    if (!create){
+        return NULL;
+    }
+    if (index->pool_size + len + 1 > index->pool_cap){
+        size_t cap = index->pool_cap ? index->pool_cap * 2 : INDEX_MIN;
+        while (cap < index->pool_size + len + 1){
+            cap *= 2;
+        }
+        char *pool = realloc(index->pool, cap);
+        if (pool == NULL){
+            return NULL;
+        }
+        index->pool = pool;
+        index->pool_cap = cap;
+    }
+    index->slots[k] = index->size;
+    IndexEntry *entry = &index->entries[index->size];
+    entry->hash = hash;
+    entry->key = index->pool_size;
+    entry->len = len;
+    entry->size = entry->cap = 0;
+    entry->edits = index->edits_size;
+    entry->pos = NULL;
+    memcpy(index->pool + index->pool_size, text, len);
+    index->pool[index->pool_size + len] = '\0';
+    index->pool_size += len + 1;
+    index->size++;
+    return entry;
 }
 
-/* Set values to temporary selection */
-void tmp_selection_set(Selection *sc, Selection *tmp_sc){
-    tmp_sc->start_row = sc->start_row;
-    tmp_sc->end_row = sc->end_row;
-    tmp_sc->start_col = sc->start_col;
-    tmp_sc->end_col = sc->end_col;
-}
-
-/* Get values from temporary selection and set them to current selection */
-void tmp_selection_use(Selection *sc, Selection *tmp_sc){
-    sc->start_row = tmp_sc->start_row;
-    sc->end_row = tmp_sc->end_row;
-    sc->start_col = tmp_sc->start_col;
-    sc->end_col = tmp_sc->end_col;
+/* Index of the first position of entry, which is not before given position 
+ * @return: entry->size if all positions are before it
+ */
+int entry_lower_bound(IndexEntry *entry, int row, int col){
+    Pos *pos = entry_positions(entry);
+    int lo = 0, hi = entry->size;
+    while (lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if (pos[mid].row < row || (pos[mid].row == row && pos[mid].col < col)){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
 }
 
-/* Uses already created selection to specify it to a certain cell in a table
- * @param sc: selection struct
- * @param arg: command from user
- * @param table: table struct
- * @return: 0 if every function was successfull (or no function was found)
- *          1 if any error occurs
+/* Add position of a cell to the entry of its text
+ * @return: 0 if successful, 1 if memory could not be allocated
  */
-int specify_selection(Selection *sc, Selection *tmp_sc, char *arg, Table *table){
-    char par1[6], par2[100];
-
-    if (!strcmp(arg, "[max]")){
-        m_selection(sc, table, "max");
-    } 
-    else if (!strcmp(arg, "[min]")){
-        m_selection(sc, table, "min");
-    } 
-    else if (char_in_string(' ', arg)){
-        if (sscanf(arg, "%5s %99s", par1, par2) == 2 && !strcmp(par1,"[find")){
-            find_selection(sc, table, par2);
-        } 
+int index_add(FindIndex *index, Cell *cell, int row, int col){
+    int len;
+    const char *text = cell_key(cell, &len);
+    if (len == 0){ //[find] has no empty pattern
+        return 0;
     }
-    else if (!strcmp(arg, "[set]")){
-        tmp_selection_set(sc, tmp_sc);
+    IndexEntry *entry = index_entry(index, text, len, true);
+    if (entry == NULL){
+        return 1;
     }
-    else if (!strcmp(arg, "[_]")){
-        tmp_selection_use(sc, tmp_sc);
+    index->positions++;
+    if (entry->size == 0){
+        entry->one = (Pos){row, col};
+        entry->size = 1;
+        if (entry->cap){
+            entry->pos[0] = entry->one;
+        }
+        return 0;
     }
-    
+    if (entry->size + 1 > (entry->cap ? entry->cap : 1)){
+        int cap = entry->cap ? entry->cap * 2 : 4;
+        Pos *pos = realloc(entry->pos, cap * sizeof(Pos));
+        if (pos == NULL){
+            return 1;
+        }
+        if (entry->cap == 0){
+            pos[0] = entry->one;
+        }
+        entry->pos = pos;
+        entry->cap = cap;
+    }
+    //cells are mostly added in row-major order when the index is built
+    int k = entry->size;
+    if (entry->pos[k-1].row > row || (entry->pos[k-1].row == row && entry->pos[k-1].col > col)){
+        k = entry_lower_bound(entry, row, col);
+        memmove(&entry->pos[k+1], &entry->pos[k], (entry->size - k) * sizeof(Pos));
+        index->work += entry->size - k;
+    }
+    entry->pos[k] = (Pos){row, col};
+    entry->size++;
     return 0;
 }
 
-/* Function used to identify if special char is valid in selection command
- * @param arg: selection command
- * @param n: ammound of SELECTION_DELIMITERS (,) before special char
+/* Remove position of a cell from the entry of its text */
+void index_remove(FindIndex *index, Cell *cell, int row, int col){
+    int len;
+    const char *text = cell_key(cell, &len);
+    IndexEntry *entry = len ? index_entry(index, text, len, false) : NULL;
+    if (entry == NULL){
+        return;
+    }
+    int k = entry_lower_bound(entry, row, col);
+    Pos *pos = entry_positions(entry);
+    if (k < entry->size && pos[k].row == row && pos[k].col == col){
+        memmove(&pos[k], &pos[k+1], (entry->size - k - 1) * sizeof(Pos));
+        index->work += entry->size - k - 1;
+        entry->size--;
+        index->positions--;
+    }
+}
+
+/* Drop the index, if updates since the last [find] moved more positions than 
+ * a rebuild would add, so commands rewriting many cells of few texts stay linear
+ */
+void index_check(FindIndex *index){
+    if (index->valid && index->work > 2 * index->positions + INDEX_MIN){
+        index_clear(index);
+    }
+}
+
+/* Log insertion or deletion of rows (columns), positions of an entry are moved when
+ * the entry is used, all entries are updated at once when the log is full
+ * @see: IndexEdit
+ */
+void index_shift(FindIndex *index, bool cols, int at, int k){
+    if (!index->valid){
+        return;
+    }
+    if (index->edits_size == INDEX_EDITS){
+        for (size_t i = 0; i < index->size; i++){
+            entry_sync(index, &index->entries[i]);
+            index->entries[i].edits = 0;
+        }
+        index->edits_size = 0;
+    }
+    index->edits[index->edits_size++] = (IndexEdit){cols, at, k};
+    index_check(index);
+}
+
+/* Build index of all cells of the table 
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int index_build(Table *table){
+    FindIndex *index = &table->index;
+    index_clear(index);
+    table_parse(table, 1, table->size);
+    for (int i = 0; i < table->size; i++){
+        for (int j = 0; j < table->rows[i].size; j++){
+            if (index_add(index, &CELL, i, j)){
+                index_clear(index);
+                return 1;
+            }
+        }
+    }
+    index->valid = true;
+    return 0;
+}
+
+/* Find the first cell with given text in row-major order within selection
+ * @param string: text to find
+ * @return: 0 if index was used (sc is set to the cell if it was found), 
+ *          1 if the table has to be searched
+ */
+int index_find(Selection *sc, Table *table, const char *string){
+    FindIndex *index = &table->index;
+    if (!index->enabled || (!index->valid && index_build(table))){
+        return 1;
+    }
+    index->work = 0;
+    IndexEntry *entry = index_entry(index, string, strlen(string), false);
+    if (entry == NULL){
+        return 0;
+    }
+    Pos *pos = entry_positions(entry);
+    int k = entry_lower_bound(entry, sc->start_row-1, sc->start_col-1);
+    while (k < entry->size && pos[k].row < sc->end_row){
+        if (pos[k].col >= sc->end_col){ //skip to selected columns of the next row
+            k = entry_lower_bound(entry, pos[k].row+1, sc->start_col-1);
+        }
+        else if (pos[k].col < sc->start_col-1){
+            k = entry_lower_bound(entry, pos[k].row, sc->start_col-1);
+        }
+        else {
+            sc->start_row = sc->end_row = pos[k].row+1;
+            sc->start_col = sc->end_col = pos[k].col+1;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/* Rewrite text of a cell in the table, the index is updated if it is valid
+ * @see: cell_rewrite
+ * @param row, col: indexes of the cell
+ */
+void table_rewrite(Table *table, int row, int col, char *string, char *delims){
+    Cell *cell = &table->rows[row].cells[col];
+    FindIndex *index = &table->index;
+    if (index->valid){
+        index_remove(index, cell, row, col);
+    }
+    cell_rewrite(&table->arena, cell, string, delims);
+    if (index->valid && index_add(index, cell, row, col)){
+        index_clear(index);
+    }
+    index_check(index);
+}
+
+/* Swap 2 cells of the table, the index is updated if it is valid
+ * @see: cell_swap
+ */
+void table_swap(Table *table, int src_row, int src_col, int dst_row, int dst_col){
+    FindIndex *index = &table->index;
+    if (src_row == dst_row && src_col == dst_col){
+        return;
+    }
+    Cell *src = &table->rows[src_row].cells[src_col];
+    Cell *dst = &table->rows[dst_row].cells[dst_col];
+    if (index->valid){
+        index_remove(index, src, src_row, src_col);
+        index_remove(index, dst, dst_row, dst_col);
+    }
+    cell_swap(table, src_row, src_col, dst_row, dst_col);
+    if (index->valid && (index_add(index, src, src_row, src_col) || 
+                         index_add(index, dst, dst_row, dst_col))){
+        index_clear(index);
+    }
+    index_check(index);
+}
+
+  /*****************************/
+ /******WRITER FUNCTIONS*******/
+/*****************************/
+
+/* Write whole buffers to descriptor, short writes and interrupts are repeated
+ * @param iov: buffers to write, they are modified
+ * @param n: number of buffers
+ * @return: 0 if successful, 1 if write failed
+ */
+int write_all(int fd, struct iovec *iov, int n){
+    while (n > 0){
+        ssize_t written = writev(fd, iov, n);
+        if (written < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            return 1;
+        }
+        while (n > 0 && (size_t)written >= iov->iov_len){ //skip written buffers
+            written -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0){
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+/* Initialize writer for output descriptor
+ * @return: 0 if successful, 1 if buffer could not be allocated
+ */
+int writer_open_fd(Writer *w, int fd){
+    w->fd = fd;
+    w->file = NULL;
+    w->size = 0;
+    w->error = false;
+    w->base = NULL;
+    w->base_size = w->pos = 0;
+    w->diverged = false;
+    w->buf = malloc(WRITE_BLOCK);
+    return w->buf == NULL;
+}
+
+/* Initialize writer for output file, pending output of the file is flushed first, 
+ * so it stays in order. Files without descriptor (memory streams) are written by fwrite
+ * @return: 0 if successful, 1 if buffer could not be allocated
+ */
+int writer_open(Writer *w, FILE *dst){
+    fflush(dst);
+    if (writer_open_fd(w, fileno(dst))){
+        return 1;
+    }
+    if (w->fd < 0){
+        w->file = dst;
+    }
+    return 0;
+}
+
+/* Compare output with prefix of original content, equal bytes are not written
+ * First different byte makes writer diverge, rest of output is written 
+ * at the same position of output descriptor
+ * @param data: additional data after buffered output, can be NULL
+ * @param n: length of data
+ */
+void writer_skip(Writer *w, const char *data, size_t n){
+    const char *parts[2] = {w->buf, data};
+    size_t lens[2] = {w->size, n};
+    w->size = 0;
+    for (int k = 0; k < 2 && !w->diverged; k++){
+        size_t same = 0, len = lens[k];
+        if (len > w->base_size - w->pos){
+            len = w->base_size - w->pos;
+        }
+        if (len && memcmp(parts[k], w->base + w->pos, len)){
+            while (parts[k][same] == w->base[w->pos + same]){
+                same++;
+            }
+        } else {
+            same = len;
+        }
+        w->pos += same;
+        if (same == lens[k]){
+            continue;
+        }
+        w->diverged = true;
+        if (lseek(w->fd, w->pos, SEEK_SET) < 0){
+            w->error = true;
+            return;
+        }
+        struct iovec iov[2] = {{(char *)parts[k] + same, lens[k] - same}, 
+                               {(char *)data, k == 0 ? n : 0}};
+        w->error = write_all(w->fd, iov, k == 0 && n ? 2 : 1);
+    }
+}
+
+/* Write buffered output followed by data, which did not fit into the buffer
+ * @param data: additional data, can be NULL
+ * @param n: length of data
+ */
+void writer_flush_with(Writer *w, const char *data, size_t n){
+    if (!w->diverged && w->base != NULL){
+        writer_skip(w, data, n);
+        return;
+    }
+    if (!w->error && w->file != NULL){
+        w->error = fwrite(w->buf, 1, w->size, w->file) != w->size ||
+                   (n && fwrite(data, 1, n, w->file) != n);
+    }
+    else if (!w->error){
+        struct iovec iov[2] = {{w->buf, w->size}, {(char *)data, n}};
+        w->error = write_all(w->fd, iov, n ? 2 : 1);
+    }
+    w->size = 0;
+}
+
+/* Append data to output
+ * @param data: data to write
+ * @param n: length of data
+ */
+void writer_put(Writer *w, const char *data, size_t n){
+    if (w->size + n > WRITE_BLOCK){
+        writer_flush_with(w, data, n);
+        return;
+    }
+    memcpy(w->buf + w->size, data, n);
+    w->size += n;
+}
+
+/* Append one character to output */
+void writer_char(Writer *w, char c){
+    if (w->size == WRITE_BLOCK){
+        writer_flush_with(w, NULL, 0);
+    }
+    w->buf[w->size++] = c;
+}
+
+/* Append content of cell, cell with delimiter is put into quotes */
+void writer_cell(Writer *w, Cell *cell){
+    if (w->size + cell->size + 2 <= WRITE_BLOCK){ //cell fits, no checks are needed
+        char *p = w->buf + w->size;
+        *p = '"';
+        p += cell->delim;
+        if (cell->size){
+            memcpy(p, cell->text, cell->size);
+            p += cell->size;
+        }
+        *p = '"';
+        p += cell->delim;
+        w->size = p - w->buf;
+        return;
+    }
+    if (cell->delim){
+        writer_char(w, '"');
+    }
+    if (cell->size){ //text of empty cell can be NULL
+        writer_put(w, cell->text, cell->size);
+    }
+    if (cell->delim){
+        writer_char(w, '"');
+    }
+}
+
+/* Flush output and free the buffer, descriptor or file stays open
+ * @return: 0 if all output was written, 1 otherwise
+ */
+int writer_close(Writer *w){
+    writer_flush_with(w, NULL, 0);
+    if (w->file != NULL && fflush(w->file)){
+        w->error = true;
+    }
+    free(w->buf);
+    w->buf = NULL;
+    return w->error;
+}
+
+/* Make renames and removals in directory of the file durable
+ * @param path: path of file in the directory
+ * @return: 0 if successful, 1 otherwise
+ */
+int sync_dir(const char *path){
+    const char *slash = strrchr(path, '/');
+    char dir[slash == NULL ? 2 : slash - path + 2];
+    if (slash == NULL){
+        strcpy(dir, ".");
+    } else {
+        memcpy(dir, path, slash - path + 1);
+        dir[slash - path + 1] = '\0';
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0){
+        return 1;
+    }
+    int error = fsync(fd) != 0;
+    return close(fd) != 0 || error;
+}
+
+/* Write whole buffer at given position of descriptor
+ * @return: 0 if successful, 1 otherwise
+ */
+int pwrite_all(int fd, const char *data, size_t n, off_t offset){
+    while (n > 0){
+        ssize_t written = pwrite(fd, data, n, offset);
+        if (written < 0 && errno == EINTR){
+            continue;
+        }
+        if (written <= 0){
+            return 1;
+        }
+        data += written;
+        n -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+/* Copy bytes between descriptors starting at the same position
+ * @param start, end: range of bytes to copy
+ * @return: 0 if successful, 1 otherwise
+ */
+int copy_range(int from, int to, off_t start, off_t end){
+    char *block = malloc(WRITE_BLOCK);
+    if (block == NULL){
+        return 1;
+    }
+    int error = 0;
+    while (!error && start < end){
+        size_t len = end - start < WRITE_BLOCK ? end - start : WRITE_BLOCK;
+        ssize_t got = pread(from, block, len, start);
+        if (got < 0 && errno == EINTR){
+            continue;
+        }
+        error = got <= 0 || pwrite_all(to, block, got, start);
+        start += got;
+    }
+    free(block);
+    return error;
+}
+
+/* Finish interrupted patch of the file - original tail is written back from journal,
+ * so the file is the same as before the patch
+ * Journal contains JOURNAL_MAGIC, start of tail, original size and original tail
+ * @param path: patched file
+ * @return: 0 if there was no journal or file was restored, 1 otherwise
+ */
+int journal_recover(const char *path){
+    char journal[strlen(path) + sizeof(JOURNAL_SUFFIX)];
+    sprintf(journal, "%s%s", path, JOURNAL_SUFFIX);
+    int jfd = open(journal, O_RDONLY);
+    if (jfd < 0){
+        return errno != ENOENT;
+    }
+    char magic[sizeof(JOURNAL_MAGIC)];
+    long long header[2]; //start of tail, original size
+    int fd = -1;
+    int error = read(jfd, magic, sizeof(magic)) != sizeof(magic) || 
+                memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) ||
+                read(jfd, header, sizeof(header)) != sizeof(header) ||
+                header[0] < 0 || header[1] < header[0] ||
+                (fd = open(path, O_WRONLY)) < 0;
+    if (!error){
+        off_t shift = sizeof(magic) + sizeof(header) - header[0]; //tail position in journal
+        char *block = malloc(WRITE_BLOCK);
+        error = block == NULL;
+        for (off_t pos = header[0]; !error && pos < header[1]; ){
+            size_t len = header[1] - pos < WRITE_BLOCK ? header[1] - pos : WRITE_BLOCK;
+            ssize_t got = pread(jfd, block, len, pos + shift);
+            error = got <= 0 || pwrite_all(fd, block, got, pos);
+            pos += got;
+        }
+        free(block);
+        error = error || ftruncate(fd, header[1]) || fsync(fd);
+    }
+    if (fd >= 0){
+        error |= close(fd) != 0;
+    }
+    close(jfd);
+    if (!error){
+        error = unlink(journal) || sync_dir(path);
+    }
+    return error;
+}
+
+/* Replace bytes of the file from the first changed byte with new content.
+ * Original bytes are saved to journal first, so crash during the patch is repaired 
+ * by journal_recover and file is never left half written
+ * @param path: file to patch
+ * @param base: original content of file
+ * @param from: first changed byte
+ * @param tmp: temporary file, which has new content from the changed byte
+ * @param size: new size of file
+ * @return: 0 if successful, 1 otherwise
+ */
+int output_patch(const char *path, Writer *w, int tmp, off_t size){
+    char journal[strlen(path) + sizeof(JOURNAL_SUFFIX)], journal_tmp[sizeof(journal) + 7];
+    sprintf(journal, "%s%s", path, JOURNAL_SUFFIX);
+    sprintf(journal_tmp, "%s.XXXXXX", journal);
+
+    int jfd = mkstemp(journal_tmp);
+    if (jfd < 0){
+        return 1;
+    }
+    long long header[2] = {w->pos, w->base_size};
+    struct iovec iov[3] = {{JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)}, {header, sizeof(header)},
+                           {(char *)w->base + w->pos, w->base_size - w->pos}};
+    int error = write_all(jfd, iov, 3) || fsync(jfd);
+    error |= close(jfd) != 0;
+    if (error || rename(journal_tmp, journal) || sync_dir(path)){
+        unlink(journal_tmp);
+        return 1;
+    }
+
+    int fd = open(path, O_WRONLY);
+    error = fd < 0 || copy_range(tmp, fd, w->pos, size) || ftruncate(fd, size) || fsync(fd);
+    if (fd >= 0){
+        error |= close(fd) != 0;
+    }
+    if (error){ //original content is put back
+        journal_recover(path);
+        return 1;
+    }
+    return unlink(journal) || sync_dir(path);
+}
+
+/* Open writer for the resulting table of a file - out or temporary file in the same 
+ * directory (-i), which replaces the file in output_close
+ * With -a output is compared with the file and only bytes after the first change 
+ * are written to temporary file
+ * @param path: input file
+ * @param out: output used without -i
+ * @param tmp: buffer for path of temporary file, strlen(path)+8 bytes
+ * @return: 0 if successful, 1 if output could not be opened
+ */
+int output_open(const Options *opts, const char *path, FILE *out, Writer *w, char *tmp){
+    if (!opts->in_place){
+        return writer_open(w, out);
+    }
+    struct stat st;
+    sprintf(tmp, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0){
+        return 1;
+    }
+    if (!stat(path, &st)){ //keep permissions of input file
+        fchmod(fd, st.st_mode & 07777);
+    }
+    if (writer_open_fd(w, fd)){
+        close(fd);
+        unlink(tmp);
+        return 1;
+    }
+    if (opts->patch && S_ISREG(st.st_mode) && st.st_size > 0){
+        int src = open(path, O_RDONLY);
+        char *map = src < 0 ? MAP_FAILED : mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, src, 0);
+        if (src >= 0){
+            close(src);
+        }
+        if (map != MAP_FAILED){
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            w->base = map;
+            w->base_size = st.st_size;
+        }
+    }
+    return 0;
+}
+
+/* Flush the resulting table and close its output
+ * With -i temporary file is synced to disk and renamed over the input file. 
+ * With -a input file is patched, when the changed tail is shorter than unchanged prefix
+ * @see: output_open
+ * @return: 0 if successful, 1 if output could not be written (input file is kept)
+ */
+int output_close(const Options *opts, const char *path, Writer *w, char *tmp){
+    int error = writer_close(w);
+    if (!opts->in_place){
+        return error;
+    }
+    if (w->base != NULL && !error){
+        if (!w->diverged && w->pos == w->base_size){ //nothing has changed
+            munmap((char *)w->base, w->base_size);
+            close(w->fd);
+            unlink(tmp);
+            return 0;
+        }
+        off_t size = w->diverged ? lseek(w->fd, 0, SEEK_END) : (off_t)w->pos;
+        if (!w->diverged || size < (off_t)w->pos){
+            error = ftruncate(w->fd, w->pos) != 0;
+            size = w->pos;
+        }
+        if (!error && w->base_size - w->pos < w->pos){ //rewriting only tail is cheaper
+            error = output_patch(path, w, w->fd, size);
+            munmap((char *)w->base, w->base_size);
+            close(w->fd);
+            unlink(tmp);
+            return error;
+        }
+        //unchanged prefix is copied to temporary file, which replaces the input
+        error = error || pwrite_all(w->fd, w->base, w->pos, 0) || ftruncate(w->fd, size);
+        munmap((char *)w->base, w->base_size);
+    }
+    error = error || fsync(w->fd) != 0;
+    error |= close(w->fd) != 0;
+    if (error || rename(tmp, path) || sync_dir(path)){
+        unlink(tmp);
+        return 1;
+    }
+    return 0;
+}
+
+  /*****************************/
+ /*******ROW FUNCTIONS*********/
+/*****************************/
+
+/* Initialize a new row with default values
+ * @return: empty initialized row
+ */
+Row row_init(){
+    Row new_row;
+    new_row.size = new_row.cap = 0;
+    new_row.cells = NULL;
+    new_row.line = NULL;
+    return new_row;
+}
+
+/* Make space for new cells in a row 
+ * @param row: row struct
+ * @param cells_n: new maximal ammount of cells
+ * @see: cell_resize
+ */
+void row_resize(Arena *arena, Row *row, int cells_n){
+    void *resized;
+    resized = arena_realloc(arena, row->cells, row->cap * sizeof(Cell), cells_n * sizeof(Cell));
+
+    if (resized != NULL){
+        row->cells = resized;
+        row->cap = cells_n;
+    }
+}
+
+/* Make sure the row has space for at least cells_n cells
+ * @see: row_resize
+ */
+void row_reserve(Arena *arena, Row *row, int cells_n){
+    if (row->cap < cells_n){
+        row_resize(arena, row, cells_n);
+    }
+}
+
+/* Append new empty cell to a row. Capacity of the row is doubled if needed */
+void row_append(Arena *arena, Row *row){
+    if (row->size+1 > row->cap){
+        row_resize(arena, row, row->cap ? row->cap * 2 : 1);
+    }
+    if (row->size+1 <= row->cap){
+        row->cells[row->size] = cell_init();
+        row->size++;
+    }
+}
+
+/* Move gap of array, so it starts at given index
+ * @param array: rows or cells
+ * @param elem: size of one element
+ * @param index: new start of gap
+ */
+void gap_move(void *array, size_t elem, Gap *gap, int index){
+    char *a = array;
+    if (index < gap->start){
+        memmove(a + (index + gap->size) * elem, a + index * elem, (gap->start - index) * elem);
+    }
+    else if (index > gap->start){
+        memmove(a + gap->start * elem, a + (gap->start + gap->size) * elem, 
+                (index - gap->start) * elem);
+    }
+    gap->start = index;
+}
+
+/* Gap of row with unused capacity at the end, cells can be inserted and deleted 
+ * through it until row_gap_close. Only cells before the gap can be accessed directly
+ */
+Gap row_gap_open(Row *row){
+    Gap gap = {row->size, row->cap - row->size};
+    return gap;
+}
+
+/* Move gap to the end of row, so cells are accessible by index again */
+void row_gap_close(Row *row, Gap *gap){
+    gap_move(row->cells, sizeof(Cell), gap, row->size);
+}
+
+/* Insert empty cells (containing '\0') at given position of row with open gap
+ * @param index: position of the first new cell
+ * @param k: number of new cells
+ */
+void row_gap_insert(Arena *arena, Row *row, Gap *gap, int index, int k){
+    if (gap->size < k){
+        row_gap_close(row, gap);
+        int cap = row->cap ? row->cap * 2 : 1;
+        row_resize(arena, row, cap > row->size + k ? cap : row->size + k);
+        gap->size = row->cap - row->size;
+        if (gap->size < k){
+            return;
+        }
+    }
+    gap_move(row->cells, sizeof(Cell), gap, index);
+    for (int i = 0; i < k; i++){
+        Cell *cell = &row->cells[gap->start++];
+        *cell = cell_init();
+        cell_append(arena, cell, '\0');
+    }
+    gap->size -= k;
+    row->size += k;
+}
+
+/* Delete cells at given position of row with open gap
+ * @param index: position of the first deleted cell
+ * @param n: number of deleted cells
+ */
+void row_gap_delete(Arena *arena, Row *row, Gap *gap, int index, int n){
+    gap_move(row->cells, sizeof(Cell), gap, index);
+    for (int i = 0; i < n; i++){
+        cell_destroy(arena, &row->cells[gap->start + gap->size + i]);
+    }
+    gap->size += n;
+    row->size -= n;
+}
+
+/* Insert new empty cells with default values (text = "\0"), row shorter than index
+ * is padded with empty cells first
+ * @param row: row struct
+ * @param index: identifies where to insert the new cells
+ * @param k: number of new cells
+ */
+void row_insert(Arena *arena, Row *row, int index, int k){
+    if (index > row->size){
+        row_reserve(arena, row, index + k);
+        while (row->size < index){
+            row_append(arena, row);
+        }
+    }
+    Gap gap = row_gap_open(row);
+    row_gap_insert(arena, row, &gap, index, k);
+    row_gap_close(row, &gap);
+}
+
+/* Delete cells [index, index+n) of a row in one pass, cells past the end are ignored
+ * @param row: row struct
+ * @param index: first deleted cell
+ * @param n: number of deleted cells
+ */
+void row_erase(Arena *arena, Row *row, int index, int n){
+    if (index >= row->size || n <= 0){
+        return;
+    }
+    if (n > row->size - index){
+        n = row->size - index;
+    }
+    Gap gap = row_gap_open(row);
+    row_gap_delete(arena, row, &gap, index, n);
+    row_gap_close(row, &gap);
+}
+
+/* @see: writer_cell
+ * @param delim: delim to separate the cells
+ * @param w: output writer
+ */
+void row_print(Row *row, char delim, Writer *w){
+    for (int i = 0; i < row->size; i++){
+        writer_cell(w, &row->cells[i]);
+        //put delimiter after each cell
+        if (i != row->size-1){
+            writer_char(w, delim);
+        }
+    }
+}
+
+/* Create cells of unparsed row (-l), texts of cells are views into its line
+ * The row keeps its size, cells past the end of the line are empty
+ * @param delim: delimiter of the line, it is the only special character in it
+ * @param end: end of mapped input
+ */
+void row_parse(Arena *arena, Row *row, char delim, const char *end){
+    const char *p = row->line, *nl = memchr(p, '\n', end - p);
+    int size = row->size;
+    *row = row_init();
+    row_reserve(arena, row, size);
+    for (int j = 0; j < size && j < row->cap; j++){
+        row_append(arena, row);
+        if (p > nl){
+            continue;
+        }
+        const char *d = memchr(p, delim, nl - p);
+        if (d == NULL){
+            d = nl;
+        }
+        if (d > p){
+            Cell *cell = &row->cells[j];
+            cell->text = (char *)p;
+            cell->size = d - p;
+            cell->view = true;
+        }
+        p = d + 1;
+    }
+}
+
+/* Copy unparsed row (-l) from input, line with more cells than size of the row is cut
+ * before its delimiter, shorter line is padded with empty cells
+ * @param end: end of mapped input
+ * @param w: output writer
+ */
+void line_print(Row *row, char delim, const char *end, Writer *w){
+    if (row->size == 0){
+        return;
+    }
+    const char *p = row->line, *nl = memchr(p, '\n', end - p);
+    int cells = 1;
+    for (const char *d; (d = memchr(p, delim, nl - p)) != NULL; p = d + 1){
+        if (cells == row->size){
+            nl = d;
+            break;
+        }
+        cells++;
+    }
+    writer_put(w, row->line, nl - row->line);
+    for (; cells < row->size; cells++){
+        writer_char(w, delim);
+    }
+}
+
+/* Width of unparsed row (-l) without empty cells (see cell_empty) at its end
+ * @param end: end of mapped input
+ * @return: number of cells up to the last nonempty one
+ */
+int line_width(Row *row, char delim, const char *end){
+    const char *p = row->line, *nl = memchr(p, '\n', end - p);
+    int width = 0;
+    for (int j = 0; j < row->size; j++){
+        const char *d = memchr(p, delim, nl - p);
+        if (d == NULL){
+            d = nl;
+        }
+        if (d > p && *p != '\0'){
+            width = j+1;
+        }
+        if (d == nl){
+            break;
+        }
+        p = d + 1;
+    }
+    return width;
+}
+
+/* Destroy all instances of cells in a row */ 
+void row_destroy(Arena *arena, Row *row){
+    if (row->line != NULL){ //unparsed row owns nothing
+        return;
+    }
+    for (int i = 0; i < row->size; i++){
+        cell_destroy(arena, &row->cells[i]);
+    }
+
+    if (row->cap)
+        arena_free(arena, row->cells, row->cap * sizeof(Cell));
+}
+
+  /*****************************/
+ /*******TABLE FUNCTIONS*******/
+/*****************************/
+
+/* Set default values to an empty table */
+void table_init(Table *table){
+    table->size = 0;
+    table->cap = 0;
+    table->rows = NULL;
+    arena_init(&table->arena);
+    columns_init(&table->columns);
+    index_init(&table->index);
+    table->map = NULL;
+    table->map_size = 0;
+    table->lazy = false;
+    table->delim = ' ';
+    table->snapshot = false;
+    table->damaged = false;
+    table->threads = 1;
+    table->visited = 0;
+    table->profile = NULL;
+}
+
+/* Make space for new rows in the table
+ * @param table: pointer to a table
+ * @param rows_n: new maximal ammount of rows
+ * @see: cell_resize
+ */
+void table_resize(Table *table, int rows_n){
+    void *resized;
+    resized = realloc(table->rows, rows_n * sizeof(Row));
+
+    if (resized != NULL){
+        table->rows = resized;
+        table->cap = rows_n;
+    }
+}
+
+/* Make sure the table has space for at least rows_n rows
+ * @see: table_resize
+ */
+void table_reserve(Table *table, int rows_n){
+    if (table->cap < rows_n){
+        table_resize(table, rows_n);
+    }
+}
+
+/* Create a new row with default values at the end of the table.
+ * Capacity of the table is doubled if needed */
+void table_append(Table *table){
+    if (table->cap == table->size){
+        table_resize(table, table->cap ? table->cap * 2 : 1);
+    }
+    if (table->size < table->cap){
+        table->rows[table->size] = row_init();
+        table->size++;
+    }
+}
+
+/* Gap of table with unused capacity at the end, rows can be inserted and deleted 
+ * through it until table_gap_close. Only rows before the gap can be accessed directly
+ */
+Gap table_gap_open(Table *table){
+    Gap gap = {table->size, table->cap - table->size};
+    return gap;
+}
+
+/* Move gap to the end of table, so rows are accessible by index again */
+void table_gap_close(Table *table, Gap *gap){
+    gap_move(table->rows, sizeof(Row), gap, table->size);
+}
+
+/* Insert rows of empty cells (containing '\0') at given position of table with open gap
+ * @param index: position of the first new row
+ * @param k: number of new rows
+ * @param width: number of cells of the new rows
+ */
+void table_gap_insert(Table *table, Gap *gap, int index, int k, int width){
+    if (gap->size < k){
+        table_gap_close(table, gap);
+        int cap = table->cap ? table->cap * 2 : 1;
+        table_resize(table, cap > table->size + k ? cap : table->size + k);
+        gap->size = table->cap - table->size;
+        if (gap->size < k){
+            return;
+        }
+    }
+    gap_move(table->rows, sizeof(Row), gap, index);
+    for (int i = 0; i < k; i++){
+        Row *row = &table->rows[gap->start++];
+        *row = row_init();
+        row_reserve(&table->arena, row, width);
+        for (int j = 0; j < width; j++){
+            row_append(&table->arena, row);
+            cell_append(&table->arena, &row->cells[j], '\0');
+        }
+    }
+    gap->size -= k;
+    table->size += k;
+}
+
+/* Delete rows at given position of table with open gap
+ * @param index: position of the first deleted row
+ * @param n: number of deleted rows
+ */
+void table_gap_delete(Table *table, Gap *gap, int index, int n){
+    gap_move(table->rows, sizeof(Row), gap, index);
+    for (int i = 0; i < n; i++){
+        row_destroy(&table->arena, &table->rows[gap->start + gap->size + i]);
+    }
+    gap->size += n;
+    table->size -= n;
+}
+
+/* Insert new rows with same number of initialized cells as the first row 
+ * @param table: table struct
+ * @param index: index in table, where new rows are created
+ * @param k: number of new rows
+ */
+void table_insert(Table *table, int index, int k){
+    if (index > table->size){
+        return;
+    }
+    int width = table->size ? table->rows->size : 0;
+    Gap gap = table_gap_open(table);
+    table_gap_insert(table, &gap, index, k, width);
+    table_gap_close(table, &gap);
+}
+
+/* Delete rows [index, index+n) of a table in one pass, rows past the end are ignored
+ * @param table: table struct
+ * @param index: first deleted row
+ * @param n: number of deleted rows
+ */
+void table_erase(Table *table, int index, int n){
+    if (index >= table->size || n <= 0){
+        return;
+    }
+    if (n > table->size - index){
+        n = table->size - index;
+    }
+    Gap gap = table_gap_open(table);
+    table_gap_delete(table, &gap, index, n);
+    table_gap_close(table, &gap);
+}
+
+/* Get length of the longest row
+ * @return: maximal row size in a table
+ */
+int get_max_row(Table table){
+    int max_row = 0;
+    
+    for (int i = 0; i < table.size; i++){
+        if (table.rows[i].size > max_row){
+            max_row = table.rows[i].size;        
+        }
+    }
+    return max_row;
+}
+
+/* Fill the table with empty cells so each row has equal ammount of cells */
+void fill_table(Table *table){
+    int max_row = get_max_row(*table);
+    
+    for (int i = 0; i < table->size; i++){
+        if (table->rows[i].line != NULL){ //cells after the line of unparsed row are empty
+            table->rows[i].size = max_row;
+            continue;
+        }
+        row_reserve(&table->arena, &table->rows[i], max_row);
+        while (table->rows[i].size != max_row){
+            row_append(&table->arena, &table->rows[i]);
+        }
+    }  
+}
+
+void record_parse(Table *table, Row *row);
+void record_print(Table *table, Row *row, char delim, Writer *w);
+int record_width(Table *table, Row *row);
+
+/* @see: row_print
+ * @param delim: delimiter of cells in the table
+ * @param w: output writer
+ */
+void table_print(Table *table,  char delim, Writer *w){
+    for (int i = 0; i < table->size; i++){
+        if (table->rows[i].line != NULL && table->snapshot){
+            record_print(table, &table->rows[i], delim, w);
+        } else if (table->rows[i].line != NULL){
+            line_print(&table->rows[i], delim, table->map + table->map_size, w);
+        } else {
+            row_print(&table->rows[i], delim, w);
+        }
+        if (i != table->size-1){
+            writer_char(w, '\n');
+        }
+    } writer_char(w, '\n');
+}
+
+/* Destroy all instances of rows in a table, their cells are released with the arena */
+void table_destroy(Table *table){
+    arena_release(&table->arena);
+    columns_destroy(&table->columns);
+    index_clear(&table->index);
+    free(table->rows);
+    table->rows = NULL;
+    table->size = table->cap = 0;
+    if (table->map != NULL){
+        munmap(table->map, table->map_size);
+    }
+}
+
+/* Add more rows or columns if the selection is bigger than the table
+ * @param table: pointer to a table structure
+ * @param new_rows: expected number of rows in updated table
+ * @param new_cols: expected number of columns in updated table
+ */
+void table_expand(Table *table, int new_rows, int new_cols){
+    table_changed(table, -1, -1); //new cells are empty, so the index stays valid
+    if (new_rows > table->size){
+        table_reserve(table, new_rows);
+        for (int i = table->size; i < new_rows; i++){
+            table_append(table);
+        }
+        fill_table(table);
+    }
+
+    for (int i = 0; i < table->size; i++){
+        if (table->rows[i].line != NULL){
+            table->rows[i].size = new_cols > table->rows[i].size ? new_cols : table->rows[i].size;
+            continue;
+        }
+        for (int j = table->rows[i].size; j < new_cols; j++){
+            row_append(&table->arena, &table->rows[i]);
+        }
+    }
+} 
+
+/* Parse unparsed rows of lazily loaded table (-l or snapshot) in range, rows outside 
+ * of the table are ignored
+ * @param start_row: first row (counted from 1)
+ * @param end_row: last row
+ */
+void table_parse(Table *table, int start_row, int end_row){
+    if (!table->lazy){
+        return;
+    }
+    const char *end = table->map + table->map_size;
+    for (int i = start_row > 1 ? start_row-1 : 0; i < end_row && i < table->size; i++){
+        if (table->rows[i].line != NULL && table->snapshot){
+            record_parse(table, &table->rows[i]);
+        } else if (table->rows[i].line != NULL){
+            row_parse(&table->arena, &table->rows[i], table->delim, end);
+        }
+    }
+}
+
+/* Initialize temporary variables with default cells */
+void variables_init(Temporary *tmp_vars){
+    for (int i = 0; i < TEMPORARY_MAX; i++){
+        tmp_vars->variables[i] = cell_init();
+    }  
+}
+
+/* Destroy all instances of temporary variables */
+void variables_destroy(Temporary *tmp_vars){
+    for (int i = 0; i < TEMPORARY_MAX; i++){
+        cell_destroy(NULL, &tmp_vars->variables[i]);
+    }
+}
+
+//State of the loader kept between blocks of input
+typedef struct {
+    Table *table;
+    unsigned char cls[256];
+    int current_row;
+    int current_cell;
+    int quotes_active; //changing sign to + or - depending whether quotes are active
+    bool escape; //last block ended with '\\'
+    bool zero_copy; //plain cells become views into the input
+    int row_cells; //number of cells in the first row, used to presize next rows
+} Loader;
+
+/* Initialize loader and its class table, so each input byte is classified only once
+ * @param ld: loader struct
+ * @param table: table to fill
+ * @param delims: delimiters from argv
+ */
+void loader_init(Loader *ld, Table *table, char *delims){
+    ld->table = table;
+    ld->current_row = ld->current_cell = 0;
+    ld->quotes_active = -1;
+    ld->escape = false;
+    ld->zero_copy = false;
+    ld->row_cells = 0;
+    memset(ld->cls, 0, sizeof(ld->cls));
+    for (size_t i = 0; delims[i] != '\0'; i++){
+        ld->cls[(unsigned char)delims[i]] |= CL_DELIM;
+    }
+    ld->cls['"'] |= CL_QUOTE;
+    ld->cls['\\'] |= CL_ESC;
+    ld->cls['\n'] |= CL_NL;
+}
+
+/* Process one block of input, runs of ordinary characters are appended at once
+ * @param ld: loader struct
+ * @param buf: block of input
+ * @param len: length of the block
+ */
+void loader_feed(Loader *ld, const char *buf, size_t len){
+    Table *table = ld->table;
+    const unsigned char *p = (const unsigned char *)buf, *end = p + len;
+
+    while (p < end){
+        if (table->size == 0){
+            table_append(table); 
+        }
+        Row *row = &table->rows[ld->current_row];
+        if (row->size == 0){
+            row_append(&table->arena, row);
+        }
+        Cell *cell = &row->cells[ld->current_cell];
+
+        if (ld->escape){
+            ld->escape = false;
+            if (ld->cls[*p] & CL_DELIM){
+                cell->delim = true;
+            }
+            cell_append(&table->arena, cell, *p++);
+            continue;
+        }
+
+        const unsigned char *run = p;
+        while (p < end && !ld->cls[*p]){
+            p++;
+        }
+        if (p != run){
+            if (ld->zero_copy && cell->text == NULL){
+                cell->text = (char *)run;
+                cell->size = p - run;
+                cell->view = true;
+            } else {
+                cell_append_n(&table->arena, cell, (const char *)run, p - run);
+            }
+            continue;
+        }
+
+        unsigned char c = *p++;
+        if (c == '\n'){ 
+            if (ld->current_row == 0){
+                ld->row_cells = row->size;
+            }
+            ld->current_cell = 0;
+            ld->current_row++;
+            table_append(table); 
+            row_reserve(&table->arena, &table->rows[ld->current_row], ld->row_cells);
+            continue;
+        } 
+        else if (c == '"'){
+            ld->quotes_active *= -1;
+        } 
+        else if (c == '\\'){
+            ld->escape = true;
+            continue;
+        }
+
+        if ((ld->cls[c] & CL_DELIM) && ld->quotes_active == -1){
+            ld->current_cell++;
+            row_append(&table->arena, row);
+            continue;
+        }
+    
+        if (ld->cls[c] & CL_DELIM){
+            cell->delim = true;
+        }
+
+        if (c != '"'){
+            cell_append(&table->arena, cell, c);
+        }
+    }
+}
+
+/* Take input from a file and insert it into table using cell,row,table structures
+ * @param table: table struct
+ * @param source: source file
+ * @param delims: delimiters from argv
+ */
+void create_table(Table *table, FILE *source, char *delims){
+    Loader ld;
+    loader_init(&ld, table, delims);
+
+    char *block = malloc(LOAD_BLOCK);
+    if (block == NULL){
+        return;
+    }
+    size_t len;
+    while ((len = fread(block, 1, LOAD_BLOCK, source)) > 0){
+        loader_feed(&ld, block, len);
+    }
+    free(block);
+
+    //delete last row, because of \n from last line in file
+    if (table->size){
+        row_destroy(&table->arena, &table->rows[table->size-1]);
+        table->size--;
+    }
+}
+
+/* Map the whole file into memory and create table, which cells are views into it
+ * Cells get their own buffer only when they are modified (see cell_own)
+ * Memory: texts are not copied, but every cell still takes a whole Cell (32 bytes) and 
+ * every row a Row (24 bytes), so a table of short cells takes several times the size 
+ * of the file, only unparsed rows of lazy mode (-l) keep it close to the file size
+ * @param table: table struct
+ * @param source: source file
+ * @param delims: delimiters from argv
+ * @return: 0 if successful, 1 if file could not be mapped (table is left empty)
+ */
+int create_table_mmap(Table *table, FILE *source, char *delims){
+    struct stat st;
+    if (fstat(fileno(source), &st) || !S_ISREG(st.st_mode) || st.st_size == 0){
+        return 1;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(source), 0);
+    if (map == MAP_FAILED){
+        return 1;
+    }
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+    table->map = map;
+    table->map_size = st.st_size;
+
+    //first pass counts lines, so the table is allocated only once
+    int lines = 1;
+    for (char *nl = map; (nl = memchr(nl, '\n', map + st.st_size - nl)) != NULL; nl++){
+        lines++;
+    }
+    table_reserve(table, lines);
+
+    Loader ld;
+    loader_init(&ld, table, delims);
+    ld.zero_copy = true;
+    loader_feed(&ld, map, st.st_size);
+
+    if (table->size){
+        row_destroy(&table->arena, &table->rows[table->size-1]);
+        table->size--;
+    }
+    return 0;
+}
+
+/* Map the whole file and index its rows, rows are parsed only when a command touches them
+ * (table_parse) and rows which were not parsed are copied from input (line_print)
+ * Only a row, which prints the same as its line, is left unparsed: it starts outside of quotes
+ * and has no quotes, escapes or delimiters other than the first one. Other rows are parsed 
+ * at once, state of quotes is followed from the start of file, as in create_table
+ * @param table: table struct
+ * @param source: source file
+ * @param delims: delimiters from argv
+ * @return: 0 if successful, 1 if file could not be mapped (table is left empty)
+ */
+int create_table_lazy(Table *table, FILE *source, char *delims){
+    struct stat st;
+    if (fstat(fileno(source), &st) || !S_ISREG(st.st_mode) || st.st_size == 0){
+        return 1;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(source), 0);
+    if (map == MAP_FAILED){
+        return 1;
+    }
+    table->map = map;
+    table->map_size = st.st_size;
+    table->lazy = true;
+    table->delim = DELIM;
+
+    //one more row for the part after the last '\n'
+    int lines = 1;
+    for (char *nl = map; (nl = memchr(nl, '\n', map + st.st_size - nl)) != NULL; nl++){
+        lines++;
+    }
+    table_reserve(table, lines);
+
+    Loader ld;
+    loader_init(&ld, table, delims);
+    ld.zero_copy = true;
+    const unsigned char *p = (const unsigned char *)map, *end = p + st.st_size;
+    bool quoted = false;
+    while (true){
+        const unsigned char *line = p;
+        bool start_quoted = quoted, plain = !quoted;
+        int cells = 1;
+        while (p < end){
+            while (p < end && !ld.cls[*p]){
+                p++;
+            }
+            if (p == end || *p == '\n'){
+                break;
+            }
+            unsigned char cls = ld.cls[*p];
+            if (cls & CL_ESC){
+                plain = false;
+                p += p + 1 < end ? 2 : 1;
+                continue;
+            }
+            if (cls & CL_QUOTE){
+                plain = false;
+                quoted = !quoted;
+            }
+            else if (cls & CL_DELIM){
+                plain = plain && *p == (unsigned char)DELIM;
+                cells += !quoted;
+            }
+            p++;
+        }
+        table_append(table);
+        Row *row = &table->rows[table->size-1];
+        if (plain && p < end){
+            row->line = (const char *)line;
+            row->size = cells;
+        } else {
+            ld.current_row = table->size-1;
+            ld.current_cell = 0;
+            ld.quotes_active = start_quoted ? 1 : -1;
+            ld.escape = false;
+            row_reserve(&table->arena, row, cells);
+            loader_feed(&ld, (const char *)line, p - line);
+            if (row->size == 0 && p < end){
+                row_append(&table->arena, row);
+            }
+        }
+        if (p == end){ //part without '\n' is dropped, as in create_table
+            row_destroy(&table->arena, row);
+            table->size--;
+            break;
+        }
+        p++;
+    }
+    return 0;
+}
+
+//Part of input parsed by one loader thread into its own table
+typedef struct {
+    const char *buf; //part starts after '\n', which is not escaped
+    size_t len;
+    char *delims;
+    bool zero_copy;
+    int quotes_active; //state of quotes at the start of the part
+    bool flips; //part contains odd number of quotes, so it changes the state for next parts
+    Table table;
+} LoadJob;
+
+/* Find start of the first row at or after given position,
+ * rows start after '\n', which is not preceded by odd number of '\\'
+ * @param pos: position in input
+ * @return: position of row start or len if there is no other row
+ */
+size_t load_row_start(const char *buf, size_t len, size_t pos){
+    while (pos < len){
+        const char *nl = memchr(buf + pos, '\n', len - pos);
+        if (nl == NULL){
+            return len;
+        }
+        size_t esc = 0;
+        while (nl - esc > buf && nl[-1 - (long)esc] == '\\'){
+            esc++;
+        }
+        pos = nl - buf + 1;
+        if (esc % 2 == 0){
+            return pos;
+        }
+    }
+    return len;
+}
+
+/* Thread of parallel loader, parses its part of input from the state of quotes in the job
+ * @param arg: LoadJob
+ */
+void * load_worker(void *arg){
+    LoadJob *job = arg;
+    table_init(&job->table);
+    int lines = 1;
+    const char *end = job->buf + job->len;
+    for (const char *nl = job->buf; (nl = memchr(nl, '\n', end - nl)) != NULL; nl++){
+        lines++;
+    }
+    table_reserve(&job->table, lines);
+
+    Loader ld;
+    loader_init(&ld, &job->table, job->delims);
+    ld.zero_copy = job->zero_copy;
+    ld.quotes_active = job->quotes_active;
+    loader_feed(&ld, job->buf, job->len);
+    job->flips = ld.quotes_active != job->quotes_active;
+    return NULL;
+}
+
+/* Run jobs on threads, jobs, which could not get a thread, run in calling thread */
+void load_parallel(LoadJob **jobs, int n){
+    pthread_t threads[n > 0 ? n : 1];
+    bool started[n > 0 ? n : 1];
+    for (int t = 1; t < n; t++){
+        started[t] = !pthread_create(&threads[t], NULL, load_worker, jobs[t]);
+    }
+    if (n > 0){
+        load_worker(jobs[0]);
+    }
+    for (int t = 1; t < n; t++){
+        if (started[t]){
+            pthread_join(threads[t], NULL);
+        } else {
+            load_worker(jobs[t]);
+        }
+    }
+}
+
+/* Map the whole file and parse it on several threads, the result is the same as of create_table.
+ * Input is split into parts at row starts, each thread parses its part into its own table 
+ * expecting quotes to be inactive at the start. Quotes can be left open over rows, so parts,
+ * which start with active quotes (after odd number of quotes before them), are parsed again.
+ * Rows of all parts are then joined into the table and arenas of parts are merged into its arena
+ * @param threads: maximal number of threads, parts are at least LOAD_PARALLEL bytes long
+ * @param zero_copy: cells are views into mapped file, which is kept in table (see create_table_mmap)
+ * @return: 0 if successful, 1 if file could not be mapped, it is too small or rows of parts
+ *          could not be joined for lack of memory (table is left empty)
+ */
+int create_table_parallel(Table *table, FILE *source, char *delims, int threads, bool zero_copy){
+    struct stat st;
+    if (fstat(fileno(source), &st) || !S_ISREG(st.st_mode) || st.st_size < 2 * LOAD_PARALLEL){
+        return 1;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(source), 0);
+    if (map == MAP_FAILED){
+        return 1;
+    }
+    size_t size = st.st_size;
+    if (threads > (long long)(size / LOAD_PARALLEL)){
+        threads = size / LOAD_PARALLEL;
+    }
+    if (threads > THREADS_MAX){
+        threads = THREADS_MAX;
+    }
+
+    LoadJob jobs[threads];
+    LoadJob *run[threads];
+    size_t start = 0;
+    for (int t = 0; t < threads; t++){
+        size_t end = t == threads-1 ? size : load_row_start(map, size, size / threads * (t+1));
+        if (end < start){
+            end = start;
+        }
+        jobs[t].buf = map + start;
+        jobs[t].len = end - start;
+        jobs[t].delims = delims;
+        jobs[t].zero_copy = zero_copy;
+        jobs[t].quotes_active = -1;
+        run[t] = &jobs[t];
+        start = end;
+    }
+    load_parallel(run, threads);
+
+    //speculation failed for parts after odd number of quotes
+    int again = 0;
+    int quotes_active = -1;
+    for (int t = 0; t < threads; t++){
+        if (quotes_active != jobs[t].quotes_active){
+            table_destroy(&jobs[t].table);
+            jobs[t].quotes_active = quotes_active;
+            run[again++] = &jobs[t];
+        }
+        if (jobs[t].flips){
+            quotes_active *= -1;
+        }
+    }
+    load_parallel(run, again);
+
+    int rows = 0;
+    for (int t = 0; t < threads; t++){
+        rows += jobs[t].table.size;
+    }
+    table_reserve(table, rows);
+    if (table->cap < rows){ //caller loads the file sequentially, which needs less memory at once
+        for (int t = 0; t < threads; t++){
+            table_destroy(&jobs[t].table);
+        }
+        munmap(map, size);
+        return 1;
+    }
+    for (int t = 0; t < threads; t++){
+        Table *part = &jobs[t].table;
+        if (part->size && table->size){ 
+            //empty row after the last '\n' of previous part is the first row of this part
+            row_destroy(&table->arena, &table->rows[table->size-1]);
+            table->size--;
+        }
+        memcpy(&table->rows[table->size], part->rows, part->size * sizeof(Row));
+        table->size += part->size;
+        arena_merge(&table->arena, &part->arena);
+        free(part->rows);
+    }
+
+    if (table->size){
+        row_destroy(&table->arena, &table->rows[table->size-1]);
+        table->size--;
+    }
+    if (zero_copy){
+        table->map = map;
+        table->map_size = size;
+    } else {
+        munmap(map, size);
+    }
+    return 0;
+}
+
+  /*****************************/
+ /*****SNAPSHOT FUNCTIONS******/
+/*****************************/
+
+/* Mix one 8-byte word into checksum of snapshot */
+unsigned long long checksum_mix(unsigned long long sum, unsigned long long word){
+    return ((sum << 5 | sum >> 59) ^ word) * 0x9E3779B97F4A7C15ULL;
+}
+
+/* Update checksum of snapshot with data, 8 bytes are processed at once,
+ * incomplete word is kept for the next call, so the result does not depend on how data is split
+ * @param c: checksum state (zeroed before the first call)
+ */
+void checksum_update(Checksum *c, const void *data, size_t n){
+    const unsigned char *p = data;
+    for (; n > 0 && c->fill > 0; p++, n--){
+        c->tail[c->fill++] = *p;
+        if (c->fill == 8){
+            unsigned long long word;
+            memcpy(&word, c->tail, 8);
+            c->sum = checksum_mix(c->sum, word);
+            c->fill = 0;
+        }
+    }
+    for (; n >= 8; p += 8, n -= 8){
+        unsigned long long word;
+        memcpy(&word, p, 8);
+        c->sum = checksum_mix(c->sum, word);
+    }
+    for (; n > 0; p++, n--){
+        c->tail[c->fill++] = *p;
+    }
+}
+
+/* Finish checksum of snapshot, bytes of the incomplete word are mixed one by one
+ * @return: checksum of all data
+ */
+unsigned long long checksum_final(Checksum *c){
+    unsigned long long sum = c->sum;
+    for (int i = 0; i < c->fill; i++){
+        sum = checksum_mix(sum, c->tail[i]);
+    }
+    return sum;
+}
+
+/* Checksum of contiguous data of snapshot */
+unsigned long long snapshot_checksum(const void *data, size_t n){
+    Checksum c = {0};
+    checksum_update(&c, data, n);
+    return checksum_final(&c);
+}
+
+/* Write data to snapshot and add it to the checksum
+ * @return: 0 if successful, 1 if write failed
+ */
+int snapshot_put(FILE *f, const void *data, size_t n, Checksum *c){
+    if (n == 0){
+        return 0;
+    }
+    checksum_update(c, data, n);
+    return fwrite(data, 1, n, f) != n;
+}
+
+/* Checksum of a record, folded to 4 bytes */
+unsigned record_checksum(Checksum *c){
+    unsigned long long sum = checksum_final(c);
+    return sum ^ sum >> 32;
+}
+
+/* Size of record of a row including its checksum, without padding
+ * @return: size in bytes, 0 if texts of the row are longer than 4-byte ends allow
+ */
+unsigned long long record_size(Row *row){
+    unsigned long long text = 0;
+    for (int j = 0; j < row->size; j++){
+        text += row->cells[j].size;
+    }
+    if (text > UINT_MAX){
+        return 0;
+    }
+    return 8 + 5ULL * row->size + text;
+}
+
+/* Fill record of a row with its checksum
+ * @param rec: buffer for the record, at least record_size bytes
+ */
+void record_build(Row *row, unsigned *rec){
+    rec[1] = row->size;
+    char *delims = (char *)(rec + 2 + row->size), *text = delims + row->size;
+    unsigned end = 0;
+    for (int j = 0; j < row->size; j++){
+        Cell *cell = &row->cells[j];
+        if (cell->size){
+            memcpy(text + end, cell->text, cell->size);
+        }
+        end += cell->size;
+        rec[2 + j] = end;
+        delims[j] = cell->delim;
+    }
+    Checksum c = {0};
+    checksum_update(&c, rec + 1, text + end - (char *)(rec + 1));
+    rec[0] = record_checksum(&c);
+}
+
+/* Check record of unparsed row of snapshot
+ * Only the mapped file is trusted, so bounds are checked before the checksum is computed
+ * @param line: start of the record in the mapped file
+ * @return: 1 if the record is valid, 0 if it is damaged
+ */
+int record_check(Table *table, const char *line){
+    const char *end = table->map + table->map_size;
+    const unsigned *rec = (const unsigned *)line;
+    if (end - line < 8 || (size_t)(end - line - 8) / 5 < rec[1]){
+        return 0;
+    }
+    unsigned n = rec[1];
+    const char *text = (const char *)(rec + 2 + n) + n;
+    unsigned len = n ? rec[1 + n] : 0;
+    if ((size_t)(end - text) < len){
+        return 0;
+    }
+    Checksum c = {0};
+    checksum_update(&c, rec + 1, text + len - line - 4);
+    bool valid = record_checksum(&c) == rec[0];
+    for (unsigned k = 0; valid && k < n; k++){
+        unsigned start = k ? rec[1 + k] : 0;
+        valid = start <= rec[2 + k] && rec[2 + k] - start < INT_MAX;
+    }
+    return valid;
+}
+
+/* Get cells of unparsed row of snapshot, a damaged record sets table->damaged
+ * The record is checked only when the row is used for the first time, the result
+ * is kept in cap of the row
+ * @param n: number of cells in the record
+ * @param delims: delim flags of cells
+ * @param text: texts of cells
+ * @return: ends of cell texts relative to text, NULL if the record is damaged
+ */
+const unsigned * record_cells(Table *table, Row *row, unsigned *n, const char **delims, 
+                              const char **text){
+    if (row->cap == 0){
+        row->cap = record_check(table, row->line) ? 1 : -1;
+    }
+    if (row->cap < 0){
+        table->damaged = true;
+        return NULL;
+    }
+    const unsigned *rec = (const unsigned *)row->line;
+    *n = rec[1];
+    *delims = (const char *)(rec + 2 + *n);
+    *text = *delims + *n;
+    return rec + 2;
+}
+
+/* Create cells of unparsed row of snapshot, texts of cells are views into its record
+ * The row keeps its size, cells past the end of the record are empty, as are all cells
+ * of a damaged record
+ */
+void record_parse(Table *table, Row *row){
+    unsigned n;
+    const char *delims, *text;
+    const unsigned *ends = record_cells(table, row, &n, &delims, &text);
+    int size = row->size;
+    *row = row_init();
+    row_reserve(&table->arena, row, size);
+    for (int j = 0; j < size && j < row->cap; j++){
+        row_append(&table->arena, row);
+        if (ends == NULL || (unsigned)j >= n){
+            continue;
+        }
+        Cell *cell = &row->cells[j];
+        unsigned start = j ? ends[j-1] : 0;
+        cell->delim = delims[j];
+        if (ends[j] > start){
+            cell->text = (char *)text + start;
+            cell->size = ends[j] - start;
+            cell->view = true;
+        }
+    }
+}
+
+/* Print unparsed row of snapshot the same way as row_print prints parsed row
+ * @param delim: delimiter of cells in the table
+ * @param w: output writer
+ */
+void record_print(Table *table, Row *row, char delim, Writer *w){
+    unsigned n;
+    const char *delims, *text;
+    const unsigned *ends = record_cells(table, row, &n, &delims, &text);
+    for (int j = 0; j < row->size; j++){
+        if (j){
+            writer_char(w, delim);
+        }
+        if (ends == NULL || (unsigned)j >= n){
+            continue;
+        }
+        Cell cell = cell_init();
+        unsigned start = j ? ends[j-1] : 0;
+        cell.text = (char *)text + start;
+        cell.size = ends[j] - start;
+        cell.delim = delims[j];
+        writer_cell(w, &cell);
+    }
+}
+
+/* Width of unparsed row of snapshot without empty cells (see cell_empty) at its end
+ * @return: number of cells up to the last nonempty one
+ */
+int record_width(Table *table, Row *row){
+    unsigned n;
+    const char *delims, *text;
+    const unsigned *ends = record_cells(table, row, &n, &delims, &text);
+    for (int j = ends == NULL ? 0 : (row->size < (long)n ? row->size : (int)n); j > 0; j--){
+        unsigned start = j > 1 ? ends[j-2] : 0;
+        if (ends[j-1] > start && text[start] != '\0'){
+            return j;
+        }
+    }
+    return 0;
+}
+
+/* Write table to a binary snapshot, which can be loaded without parsing (create_table_snapshot)
+ * File is written under temporary name and renamed, so an old snapshot is replaced at once
+ * @param path: snapshot file
+ * @return: 0 if successful, 1 if snapshot could not be written
+ */
+int snapshot_write(Table *table, const char *path){
+    table_parse(table, 1, table->size);
+    SnapshotHeader h;
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.rows = table->size;
+    h.cells = h.data_size = 0;
+    for (int i = 0; i < table->size; i++){
+        unsigned long long size = record_size(&table->rows[i]);
+        if (size == 0){
+            return 1;
+        }
+        h.cells += table->rows[i].size;
+        h.data_size += (size + 3) / 4 * 4;
+    }
+    if (table->damaged){
+        return 1;
+    }
+    Checksum c = {0};
+
+    char tmp[strlen(path)+8];
+    sprintf(tmp, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd >= 0){
+        //mkstemp creates the file readable only by the owner, snapshot gets the usual mode
+        mode_t mask = umask(0);
+        umask(mask);
+        fchmod(fd, 0666 & ~mask);
+    }
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (f == NULL){
+        if (fd >= 0){
+            close(fd);
+            unlink(tmp);
+        }
+        return 1;
+    }
+    setvbuf(f, NULL, _IOFBF, WRITE_BLOCK);
+    int error = fwrite(&h, sizeof(h), 1, f) != 1;
+    unsigned long long offset = 0;
+    for (int i = 0; i <= table->size && !error; i++){
+        error = snapshot_put(f, &offset, 8, &c);
+        offset += i < table->size ? (record_size(&table->rows[i]) + 3) / 4 * 4 : 0;
+    }
+    for (int i = 0; i < table->size && !error; i++){
+        unsigned size = table->rows[i].size;
+        error = snapshot_put(f, &size, 4, &c);
+    }
+    char padding[8] = {0};
+    error = error || snapshot_put(f, padding, table->size % 2 * 4, &c);
+    h.checksum = checksum_final(&c);
+    unsigned *rec = NULL;
+    size_t rec_cap = 0;
+    for (int i = 0; i < table->size && !error; i++){
+        size_t size = (record_size(&table->rows[i]) + 3) / 4 * 4;
+        if (size > rec_cap){
+            free(rec);
+            rec_cap = size > 2 * rec_cap ? size : 2 * rec_cap;
+            rec = malloc(rec_cap);
+            if (rec == NULL){
+                error = 1;
+                break;
+            }
+        }
+        rec[size / 4 - 1] = 0; //padding
+        record_build(&table->rows[i], rec);
+        error = fwrite(rec, 1, size, f) != size;
+    }
+    free(rec);
+    error = error || fseek(f, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, f) != 1;
+    error = fclose(f) || error || rename(tmp, path);
+    if (error){
+        unlink(tmp);
+    }
+    return error;
+}
+
+/* Map binary snapshot and create table of unparsed rows, which point to their records,
+ * nothing is read except of the row index, rows are parsed when a command touches them 
+ * and unparsed rows are printed from their records (see record_parse and record_print)
+ * Records are checked when they are used, a damaged one sets table->damaged
+ * @param source: file, which is loaded only if it starts with SNAPSHOT_MAGIC
+ * @return: 0 if successful, 1 if file is not a snapshot, its header or row index is not valid
+ *          (file is parsed as text) or 2 if memory is short, table is left empty if not successful
+ */
+int create_table_snapshot(Table *table, FILE *source){
+    struct stat st;
+    if (fstat(fileno(source), &st) || !S_ISREG(st.st_mode) || st.st_size < (off_t)sizeof(SnapshotHeader)){
+        return 1;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(source), 0);
+    if (map == MAP_FAILED){
+        return 1;
+    }
+    SnapshotHeader h;
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic))){
+        munmap(map, st.st_size);
+        return 1;
+    }
+
+    //sizes are checked before they are multiplied, so the layout can not overflow
+    size_t size = st.st_size;
+    const unsigned long long *offsets = (const unsigned long long *)(map + sizeof(h));
+    const unsigned *sizes = NULL;
+    const char *data = NULL;
+    size_t index_size = (h.rows + 1) * 8 + (h.rows + 1) / 2 * 8;
+    bool valid = h.rows < INT_MAX && h.data_size < size && 
+                 sizeof(h) + index_size + h.data_size == size &&
+                 snapshot_checksum(offsets, index_size) == h.checksum;
+    if (valid){
+        sizes = (const unsigned *)(offsets + h.rows + 1);
+        data = (const char *)offsets + index_size;
+        valid = offsets[0] == 0 && offsets[h.rows] == h.data_size;
+    }
+    unsigned long long cells = 0;
+    for (unsigned long long i = 0; valid && i < h.rows; i++){
+        valid = offsets[i] + 8 <= offsets[i+1] && offsets[i+1] % 4 == 0 && sizes[i] < INT_MAX;
+        cells += sizes[i];
+    }
+    if (!valid || cells != h.cells){
+        munmap(map, st.st_size);
+        return 1;
+    }
+    table_reserve(table, h.rows);
+    if (table->cap < (long long)h.rows){
+        munmap(map, st.st_size);
+        return 2;
+    }
+    table->map = map;
+    table->map_size = size;
+    table->lazy = true;
+    table->snapshot = true;
+    for (unsigned long long i = 0; i < h.rows; i++){
+        table_append(table);
+        table->rows[i].line = data + offsets[i];
+        table->rows[i].size = sizes[i];
+    }
+    return 0;
+}
+
+/* Extract options, command sequence and file from program arguments
+ * Options (-d DELIM, -m, -l, -s, -c, -f, -p FILE, -b, -j N, -o DIR, -r, -t N, -P DEST, 
+ * -w FILE, -i, -a) are placed before the command sequence
+ * In batch mode (-b) the command sequence is followed by any number of files
+ * @param opts: options struct to fill
+ * @return: 0 if successful, 1 if arguments are invalid
+ */
+int parse_options(const Args args, Options *opts){
+    opts->delims = " ";
+    opts->mmap = false;
+    opts->lazy = false;
+    opts->stats = false;
+    opts->columnar = false;
+    opts->find_index = false;
+    opts->program = NULL;
+    opts->in_place = false;
+    opts->patch = false;
+    opts->batch = false;
+    opts->jobs = 0;
+    opts->out_dir = NULL;
+    opts->stream = false;
+    opts->threads = 1;
+    opts->profile = NULL;
+    opts->snapshot = NULL;
+
+    int i;
+    for (i = 1; i < args.argc-1 && args.argv[i][0] == '-'; i++){
+        if (!strcmp(args.argv[i], "-d")){
+            opts->delims = args.argv[++i];
+        }
+        else if (!strcmp(args.argv[i], "-m")){
+            opts->mmap = true;
+        }
+        else if (!strcmp(args.argv[i], "-l")){
+            opts->lazy = true;
+        }
+        else if (!strcmp(args.argv[i], "-s")){
+            opts->stats = true;
+        }
+        else if (!strcmp(args.argv[i], "-c")){
+            opts->columnar = true;
+        }
+        else if (!strcmp(args.argv[i], "-f")){
+            opts->find_index = true;
+        }
+        else if (!strcmp(args.argv[i], "-p")){
+            opts->program = args.argv[++i];
+        }
+        else if (!strcmp(args.argv[i], "-b")){
+            opts->batch = true;
+        }
+        else if (!strcmp(args.argv[i], "-j")){
+            if (sscanf(args.argv[++i], "%d", &opts->jobs) != 1 || opts->jobs <= 0){
+                return 1;
+            }
+        }
+        else if (!strcmp(args.argv[i], "-o")){
+            opts->out_dir = args.argv[++i];
+        }
+        else if (!strcmp(args.argv[i], "-r")){
+            opts->stream = true;
+        }
+        else if (!strcmp(args.argv[i], "-t")){
+            if (sscanf(args.argv[++i], "%d", &opts->threads) != 1 || opts->threads <= 0){
+                return 1;
+            }
+        }
+        else if (!strcmp(args.argv[i], "-w")){
+            opts->snapshot = args.argv[++i];
+        }
+        else if (!strcmp(args.argv[i], "-P")){
+            opts->profile = args.argv[++i];
+        }
+        else if (!strcmp(args.argv[i], "-i")){
+            opts->in_place = true;
+        }
+        else if (!strcmp(args.argv[i], "-a")){
+            opts->in_place = opts->patch = true;
+        }
+        else {
+            return 1;
+        }
+    }
+    if (i >= args.argc || (!opts->batch && i != args.argc-2)){
+        return 1;
+    }
+    if (opts->snapshot != NULL && (opts->batch || opts->in_place || opts->stream)){
+        return 1; //only one table can be written to the snapshot
+    }
+    opts->cmd_seq = args.argv[i];
+    opts->file = args.argv[i+1];
+    opts->files = &args.argv[i+1];
+    opts->nfiles = args.argc-i-1;
+    return 0;
+}
+
+
+
+/* Temporary function for selection to print out selected cells */
+void print_selection(Selection *sc, Table *table, FILE *dst){  
+    for (int i = sc->start_row-1; i < sc->end_row; i++){
+        for (int j = sc->start_col-1; j < sc->end_col; j++){
+            cell_print(&table->rows[i].cells[j], dst);
+            fputc(' ', dst);
+        }
+    }  
+    table->visited += (long long)(sc->end_row - sc->start_row + 1) * (sc->end_col - sc->start_col + 1);
+}
+
+/* Resizing the table if new selection bigger than the table size */
+void check_table_size(Selection *sc, Table *table){
+    if (sc->end_row > table->size){
+        table_expand(table, sc->end_row, 0);
+    } 
+    if (sc->end_col > get_max_row(*table)){
+        table_expand(table, 0, sc->end_col);
+    }
+}
+
+/* Return index of n-th character in a string
+ * @param c: string: character to find in string
+ * @param n: occurance of number in a string
+ * @return: index of found character or 0 if no character was found 
+ */
+int char_index(char c, char *string, int n){
+    int counter = 0;
+    for (int i = 0; string[i] != '\0'; i++){
+        if (string[i] == c){
+            counter++;
+            if (counter == n){
+                return i;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Returns number of characters in a string */
+int char_in_string(char c, char *string){
+    int counter = 0;
+    char *temp = strchr(string,c);
+    while (temp != NULL){
+        counter++;
+        temp = strchr(temp+1, c);
+    }
+    return counter;
+}
+
+//Numeric values of a selection in row-major order
+typedef struct {
+    int n;
+    double *vals;
+    unsigned char *ok; //1 if cell contains a number
+    bool owned; //arrays were allocated for the selection, not borrowed from a column
+} Numbers;
+
+/* Collect numeric values of the selection into contiguous arrays
+ * A single column of the columnar store is used directly without copying
+ * @param nums: numbers struct to fill
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int selection_numbers(Selection *sc, Table *table, Numbers *nums){
+    int rows = sc->end_row - sc->start_row + 1, cols = sc->end_col - sc->start_col + 1;
+    nums->n = rows * cols;
+    nums->owned = true;
+
+    if (table->columns.enabled){
+        Column *columns[sc->end_col];
+        if (columns_reserve(&table->columns, sc->end_col))
+            return 1;
+        for (int j = sc->start_col-1; j < sc->end_col; j++){
+            columns[j] = column_get(table, j);
+            if (columns[j] == NULL || column_parse(columns[j]))
+                return 1;
+        }
+        if (cols == 1){
+            nums->vals = columns[sc->start_col-1]->nums + sc->start_row-1;
+            nums->ok = columns[sc->start_col-1]->num_ok + sc->start_row-1;
+            nums->owned = false;
+            return 0;
+        }
+        nums->vals = malloc(nums->n * sizeof(double));
+        nums->ok = malloc(nums->n);
+        if (nums->vals == NULL || nums->ok == NULL){
+            free(nums->vals); free(nums->ok);
+            return 1;
+        }
+        int k = 0;
+        for (int i = sc->start_row-1; i < sc->end_row; i++){
+            for (int j = sc->start_col-1; j < sc->end_col; j++, k++){
+                nums->vals[k] = columns[j]->nums[i];
+                nums->ok[k] = columns[j]->num_ok[i];
+            }
+        }
+        return 0;
+    }
+
+    nums->vals = malloc(nums->n * sizeof(double));
+    nums->ok = malloc(nums->n);
+    if (nums->vals == NULL || nums->ok == NULL){
+        free(nums->vals); free(nums->ok);
+        return 1;
+    }
+    int k = 0;
+    for (int i = sc->start_row-1; i < sc->end_row; i++){
+        for (int j = sc->start_col-1; j < sc->end_col; j++, k++){
+            nums->vals[k] = 0;
+            nums->ok[k] = !cell_to_double(&table->rows[i].cells[j], &nums->vals[k]);
+        }
+    }
+    return 0;
+}
+
+/* Free arrays of numbers, if they are not borrowed from a column */
+void numbers_free(Numbers *nums){
+    if (nums->owned){
+        free(nums->vals);
+        free(nums->ok);
+    }
+}
+
+/* Max/Min selection specifier - function to find minimal or maximal numeric value in selection
+ * First of equal values (in row-major order) is selected
+ * @param sc: selection struct
+ * @param table: table struct
+ * @param str: can be "min" or "max"
+ */
+void m_selection(Selection *sc, Table *table, char *str){
+    Numbers nums;
+    if (selection_numbers(sc, table, &nums)){
+        return;
+    }
+    int index = kernels_get()->arg_extreme(nums.vals, nums.ok, nums.n, !strcmp(str, "max"));
+    numbers_free(&nums);
+    table->visited += nums.n;
+    if (index < 0){
+        return;
+    }
+    int cols = sc->end_col - sc->start_col + 1;
+    sc->start_row = sc->end_row = sc->start_row + index / cols;
+    sc->start_col = sc->end_col = sc->start_col + index % cols;
+}
+
+/* Find first occurance of needle in memory, candidates are found by memchr
+ * of the first byte of needle
+ * @return: pointer to the occurance, NULL if there is none
+ */
+const char * find_bytes(const char *hay, size_t n, const char *needle, size_t len){
+    if (len == 0){
+        return hay;
+    }
+    const char *end = hay + n;
+    while ((size_t)(end - hay) >= len){
+        const char *p = memchr(hay, needle[0], end - hay - len + 1);
+        if (p == NULL){
+            return NULL;
+        }
+        if (!memcmp(p+1, needle+1, len-1)){
+            return p;
+        }
+        hay = p+1;
+    }
+    return NULL;
+}
+
+/* Prepare pattern of search selection
+ * @param op: OP_FIND, OP_CONTAINS, OP_PREFIX or OP_REGEX
+ * @param str: pattern
+ * @return: 0 if successful, 1 if regular expression is not valid
+ */
+int matcher_init(Matcher *m, Opcode op, const char *str){
+    m->op = op;
+    m->str = str;
+    m->len = strlen(str);
+    m->buf = NULL;
+    m->buf_cap = 0;
+    if (op == OP_REGEX && regcomp(&m->re, str, REG_EXTENDED | REG_NOSUB)){
+        return 1;
+    }
+    return 0;
+}
+
+/* Free compiled pattern */
+void matcher_destroy(Matcher *m){
+    if (m->op == OP_REGEX){
+        regfree(&m->re);
+    }
+    free(m->buf);
+}
+
+/* Check if terminated text matches the pattern */
+bool matcher_string(Matcher *m, const char *text){
+    switch (m->op){
+        case OP_FIND:
+            return !strcmp(text, m->str);
+        case OP_PREFIX:
+            return !strncmp(text, m->str, m->len);
+        case OP_CONTAINS:
+            return find_bytes(text, strlen(text), m->str, m->len) != NULL;
+        case OP_REGEX:
+            return !regexec(&m->re, text, 0, NULL, 0);
+        default:
+            return false;
+    }
+}
+
+/* Check if text of a cell (up to the first '\0', as compared by [find]) matches the pattern 
+ * Text is copied only for regexec, which needs terminated string
+ */
+bool matcher_cell(Matcher *m, Cell *cell){
+    int len;
+    const char *text = cell_key(cell, &len);
+    switch (m->op){
+        case OP_FIND:
+            return len == m->len && !memcmp(text, m->str, len);
+        case OP_PREFIX:
+            return len >= m->len && !memcmp(text, m->str, m->len);
+        case OP_CONTAINS:
+            return find_bytes(text, len, m->str, m->len) != NULL;
+        case OP_REGEX:
+            if ((size_t)len + 1 > m->buf_cap){
+                char *buf = realloc(m->buf, len + 1);
+                if (buf == NULL){
+                    return false;
+                }
+                m->buf = buf;
+                m->buf_cap = len + 1;
+            }
+            memcpy(m->buf, text, len);
+            m->buf[len] = '\0';
+            return !regexec(&m->re, m->buf, 0, NULL, 0);
+        default:
+            return false;
+    }
+}
+
+/* First row of column with cell matching the pattern, [contains] scans whole pool
+ * of the column at once, the pattern can not span cells, because it has no '\0'
+ * @param first, last: range of searched rows [first, last)
+ * @return: index of the row, last if there is none
+ */
+int column_match(Column *col, Matcher *m, int first, int last){
+    if (m->op != OP_CONTAINS){
+        for (int i = first; i < last; i++){
+            if (matcher_string(m, col->pool + col->offs[i])){
+                return i;
+            }
+        }
+        return last;
+    }
+    const char *pool = col->pool;
+    size_t pos = col->offs[first], end = col->offs[last];
+    while (pos < end){
+        const char *hit = find_bytes(pool + pos, end - pos, m->str, m->len);
+        if (hit == NULL){
+            return last;
+        }
+        //row of the hit, offs[lo] <= hit < offs[lo+1]
+        size_t off = hit - pool;
+        int lo = first, hi = last - 1;
+        while (lo < hi){
+            int mid = lo + (hi - lo + 1) / 2;
+            if (col->offs[mid] <= off){
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if (memchr(pool + col->offs[lo], '\0', off - col->offs[lo]) == NULL){
+            return lo;
+        }
+        pos = col->offs[lo+1]; //hit is after '\0' inside of the cell
+    }
+    return last;
+}
+
+/* Find first cell matching the pattern in row-major order within selection
+ * @param sc: selection struct
+ * @param table: table struct
+ * @param op: OP_FIND (whole text), OP_CONTAINS, OP_PREFIX or OP_REGEX
+ * @param string: pattern
+ */
+void find_selection(Selection *sc, Table *table, Opcode op, const char *string){
+    if (sc->end_row < sc->start_row || sc->end_col < sc->start_col || sc->end_col <= 0){
+        return; //empty selection, it also can not size the array of columns
+    }
+    if (op == OP_FIND && !index_find(sc, table, string)){
+        return;
+    }
+    Matcher m;
+    if (matcher_init(&m, op, string)){
+        return;
+    }
+    if (table->columns.enabled){
+        Column *cols[sc->end_col];
+        if (columns_reserve(&table->columns, sc->end_col)){
+            matcher_destroy(&m);
+            return;
+        }
+        for (int j = sc->start_col-1; j < sc->end_col; j++){
+            if ((cols[j] = column_get(table, j)) == NULL){
+                matcher_destroy(&m);
+                return;
+            }
+        }
+        //columns after the best one have to match in an earlier row
+        int row = sc->end_row, col = 0;
+        for (int j = sc->start_col-1; j < sc->end_col; j++){
+            int i = column_match(cols[j], &m, sc->start_row-1, row);
+            table->visited += (i < row ? i+1 : row) - (sc->start_row-1);
+            if (i < row){
+                row = i;
+                col = j;
+            }
+        }
+        if (row < sc->end_row){
+            sc->start_row = sc->end_row = row+1;
+            sc->start_col = sc->end_col = col+1;
+        }
+        matcher_destroy(&m);
+        return;
+    }
+    int cols = sc->end_col - sc->start_col + 1;
+    for (int i = sc->start_row-1; i < sc->end_row; i++){
+        for (int j = sc->start_col-1; j < sc->end_col; j++){
+            if (matcher_cell(&m, &CELL)){
+                table->visited += (long long)(i - sc->start_row+1) * cols + j - sc->start_col+2;
+                sc->start_row = sc->end_row = i+1;
+                sc->start_col = sc->end_col = j+1;
+                matcher_destroy(&m);
+                return;
+            }
+        }
+    }
+    table->visited += (long long)(sc->end_row - sc->start_row + 1) * cols;
+    matcher_destroy(&m);
+}
+
+/* Set values to temporary selection */
+void tmp_selection_set(Selection *sc, Selection *tmp_sc){
+    tmp_sc->start_row = sc->start_row;
+    tmp_sc->end_row = sc->end_row;
+    tmp_sc->start_col = sc->start_col;
+    tmp_sc->end_col = sc->end_col;
+}
+
+/* Get values from temporary selection and set them to current selection */
+void tmp_selection_use(Selection *sc, Selection *tmp_sc){
+    sc->start_row = tmp_sc->start_row;
+    sc->end_row = tmp_sc->end_row;
+    sc->start_col = tmp_sc->start_col;
+    sc->end_col = tmp_sc->end_col;
+}
+
+  /*****************************/
+ /*******SORT FUNCTIONS********/
+/*****************************/
+
+/* Compare sort keys, non-numbers are after numbers in numeric sort in both directions
+ * @return: negative if a goes before b, 0 if their order is kept
+ */
+int sort_compare(const SortJob *job, const SortKey *a, const SortKey *b){
+    int cmp;
+    if (job->numeric){
+        if (a->num_ok != b->num_ok){
+            return b->num_ok - a->num_ok;
+        }
+        cmp = a->num_ok ? (a->num > b->num) - (a->num < b->num) : 0;
+    } else {
+        cmp = memcmp(a->text, b->text, a->len < b->len ? a->len : b->len);
+        if (cmp == 0){
+            cmp = a->len - b->len;
+        }
+    }
+    return job->desc ? -cmp : cmp;
+}
+
+/* Merge sorted runs keys[lo,mid) and keys[mid,hi), equal keys of the left run go first
+ * @param tmp: buffer, which is used for the merged run
+ */
+void sort_merge(const SortJob *job, SortKey *keys, SortKey *tmp, int lo, int mid, int hi){
+    if (lo == mid || mid == hi || sort_compare(job, &keys[mid-1], &keys[mid]) <= 0){
+        return; //already in order
+    }
+    int i = lo, j = mid, k = lo;
+    while (i < mid && j < hi){
+        tmp[k++] = sort_compare(job, &keys[j], &keys[i]) < 0 ? keys[j++] : keys[i++];
+    }
+    while (i < mid){
+        tmp[k++] = keys[i++];
+    }
+    memcpy(&keys[lo], &tmp[lo], (j - lo) * sizeof(SortKey));
+}
+
+/* Stable merge sort of keys[lo,hi), short runs are sorted by insertion */
+void sort_run(const SortJob *job, SortKey *keys, SortKey *tmp, int lo, int hi){
+    if (hi - lo <= SORT_RUN){
+        for (int i = lo+1; i < hi; i++){
+            SortKey key = keys[i];
+            int j = i;
+            for (; j > lo && sort_compare(job, &key, &keys[j-1]) < 0; j--){
+                keys[j] = keys[j-1];
+            }
+            keys[j] = key;
+        }
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    sort_run(job, keys, tmp, lo, mid);
+    sort_run(job, keys, tmp, mid, hi);
+    sort_merge(job, keys, tmp, lo, mid, hi);
+}
+
+/* Thread of sort, extracts keys of its rows and sorts them
+ * @param arg: SortJob
+ */
+void * sort_worker(void *arg){
+    SortJob *job = arg;
+    for (int i = job->lo; i < job->hi; i++){
+        Row *row = &job->table->rows[job->first + i];
+        SortKey *key = &job->keys[i];
+        key->row = i;
+        key->text = "";
+        key->len = 0;
+        key->num_ok = false;
+        if (job->col < row->size){
+            Cell *cell = &row->cells[job->col];
+            key->text = cell_key(cell, &key->len);
+            key->num_ok = job->numeric && !cell_to_double(cell, &key->num) && !isnan(key->num);
+        }
+    }
+    sort_run(job, job->keys, job->tmp, job->lo, job->hi);
+    return NULL;
+}
+
+/* Thread of sort, merges two sorted runs
+ * @param arg: SortJob
+ */
+void * sort_merger(void *arg){
+    SortJob *job = arg;
+    sort_merge(job, job->keys, job->tmp, job->lo, job->mid, job->hi);
+    return NULL;
+}
+
+/* Run jobs on threads, jobs, which could not get a thread, run in calling thread */
+void sort_parallel(SortJob *jobs, int n, void * (*fn)(void *)){
+    pthread_t threads[n];
+    bool started[n];
+    for (int t = 1; t < n; t++){
+        started[t] = !pthread_create(&threads[t], NULL, fn, &jobs[t]);
+    }
+    fn(&jobs[0]);
+    for (int t = 1; t < n; t++){
+        if (started[t]){
+            pthread_join(threads[t], NULL);
+        } else {
+            fn(&jobs[t]);
+        }
+    }
+}
+
+/* Stable sort of selected rows by the first selected column, cells are not moved, 
+ * only headers of rows. Large ranges are split between threads, which sort their 
+ * parts, then the parts are merged in pairs
+ * @param sc: selected rows and key column
+ * @param ins: OP_SORT instruction with direction and type of keys
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int sort_selection(Selection *sc, Table *table, Instr *ins){
+    int first = sc->start_row-1;
+    int n = sc->end_row - first;
+    if (n < 2){
+        return 0;
+    }
+    SortKey *keys = malloc(2 * (size_t)n * sizeof(SortKey));
+    if (keys == NULL){
+        return 1;
+    }
+    SortJob job = {table, first, sc->start_col-1, ins->par[0], ins->par[1], keys, keys + n, 0, 0, n};
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = n / SORT_PARALLEL;
+    if (threads > cpus){
+        threads = cpus;
+    }
+    if (threads > SORT_THREADS){
+        threads = SORT_THREADS;
+    }
+    if (threads < 1){
+        threads = 1;
+    }
+
+    SortJob jobs[threads];
+    for (int t = 0; t < threads; t++){
+        jobs[t] = job;
+        jobs[t].lo = (long)n * t / threads;
+        jobs[t].hi = (long)n * (t+1) / threads;
+    }
+    sort_parallel(jobs, threads, sort_worker);
+    for (int width = 1; width < threads; width *= 2){
+        int merges = 0;
+        for (int t = 0; t + width < threads; t += 2*width){
+            jobs[merges] = job;
+            jobs[merges].lo = (long)n * t / threads;
+            jobs[merges].mid = (long)n * (t+width) / threads;
+            int end = t + 2*width < threads ? t + 2*width : threads;
+            jobs[merges].hi = (long)n * end / threads;
+            merges++;
+        }
+        sort_parallel(jobs, merges, sort_merger);
+    }
+
+    //merge buffer is reused for headers of rows in the new order
+    Row *rows = (Row *)job.tmp;
+    for (int i = 0; i < n; i++){
+        rows[i] = table->rows[first + keys[i].row];
+    }
+    memcpy(&table->rows[first], rows, n * sizeof(Row));
+    free(keys);
+    table->visited += n;
+
+    table_changed(table, -1, -1);
+    index_clear(&table->index); //rows of cells changed
+    return 0;
+}
+
+  /*****************************/
+ /*******GROUP FUNCTIONS*******/
+/*****************************/
+
+/* Free all groups */
+void groups_destroy(GroupTable *gt){
+    free(gt->slots);
+    gt->slots = NULL;
+    gt->size = 0;
+    gt->cap = 0;
+}
+
+/* Double number of slots, groups are moved to new slots by their stored hashes
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int groups_rehash(GroupTable *gt){
+    size_t cap = gt->cap ? gt->cap * 2 : GROUP_MIN;
+    Group *slots = malloc(cap * sizeof(Group));
+    if (slots == NULL){
+        return 1;
+    }
+    for (size_t k = 0; k < cap; k++){
+        slots[k].len = -1;
+    }
+    for (size_t i = 0; i < gt->cap; i++){
+        if (gt->slots[i].len >= 0){
+            size_t k = gt->slots[i].hash & (cap-1);
+            while (slots[k].len >= 0){
+                k = (k+1) & (cap-1);
+            }
+            slots[k] = gt->slots[i];
+        }
+    }
+    free(gt->slots);
+    gt->slots = slots;
+    gt->cap = cap;
+    return 0;
+}
+
+/* Find group of a key with linear probing, whole group is in one slot, so a probe 
+ * usually reads one cache line
+ * @return: the group (new groups are empty), NULL if memory could not be allocated
+ */
+Group * groups_get(GroupTable *gt, const char *key, int len){
+    if ((size_t)(gt->size+1) * 4 > gt->cap * 3 && groups_rehash(gt)){
+        return NULL;
+    }
+    unsigned long long hash = index_hash(key, len);
+    size_t k = hash & (gt->cap-1);
+    for (; gt->slots[k].len >= 0; k = (k+1) & (gt->cap-1)){
+        Group *g = &gt->slots[k];
+        if (g->hash == hash && g->len == len && 
+            !memcmp(g->head, key, len < GROUP_HEAD ? len : GROUP_HEAD) &&
+            (len <= GROUP_HEAD || !memcmp(g->key, key, len))){
+            return g;
+        }
+    }
+    Group *g = &gt->slots[k];
+    *g = (Group){{0}, key, len, gt->size++, hash, 0, 0};
+    memcpy(g->head, key, len < GROUP_HEAD ? len : GROUP_HEAD);
+    return g;
+}
+
+/* Aggregate value column over groups of selected rows with the same text of key cell
+ * (the first selected column) in one pass, one row with the key and the result is 
+ * appended to the table for each group, in order of first rows of the groups
+ * Memory: all groups are kept in memory, a slot takes 56 bytes and 3/8 to 3/4 of slots
+ * is used (only first GROUP_HEAD bytes of keys are copied), so 10M distinct keys need 
+ * 0.75 to 1.5 GB. There is no spilling to disk, if memory runs out, 
+ * the command fails and the table is not changed
+ * @param ins: OP_GROUP instruction with function and value column
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int group_selection(Selection *sc, Table *table, Instr *ins, char *delims){
+    Opcode op = ins->par[0];
+    int key_col = sc->start_col-1, val_col = ins->par[1]-1;
+    GroupTable gt = {0, 0, NULL};
+
+    for (int i = sc->start_row-1; i < sc->end_row; i++){
+        Row *row = &table->rows[i];
+        int len = 0;
+        const char *key = key_col < row->size ? cell_key(&row->cells[key_col], &len) : "";
+        Group *g = groups_get(&gt, key, len);
+        if (g == NULL){
+            groups_destroy(&gt);
+            return 1;
+        }
+        if (val_col >= row->size){
+            continue;
+        }
+        Cell *cell = &row->cells[val_col];
+        double num;
+        if (op == OP_COUNT){
+            g->count += !cell_empty(cell);
+        }
+        else if (!cell_to_double(cell, &num)){
+            g->sum += num;
+            g->count++;
+        }
+    }
+
+    int first = table->size;
+    int max_len = 0;
+    Group **groups = malloc(gt.size * sizeof(Group *) + 1); //groups in order of first rows
+    for (size_t k = 0; groups != NULL && k < gt.cap; k++){
+        if (gt.slots[k].len >= 0){
+            groups[gt.slots[k].order] = &gt.slots[k];
+            max_len = gt.slots[k].len > max_len ? gt.slots[k].len : max_len;
+        }
+    }
+    char *text = malloc(max_len + 50);
+    if (groups == NULL || text == NULL){
+        free(groups);
+        free(text);
+        groups_destroy(&gt);
+        return 1;
+    }
+    //key texts stay valid, new rows do not move text of existing cells
+    table_insert(table, first, gt.size);
+    if (table->size && table->rows->size < 2){
+        table_expand(table, 0, 2);
+    }
+    for (int g = 0; g < gt.size; g++){
+        Group *group = groups[g];
+        memcpy(text, group->key, group->len);
+        text[group->len] = '\0';
+        table_rewrite(table, first + g, 0, text, delims);
+        double result = op == OP_SUM ? group->sum : 
+                        op == OP_AVG ? group->sum / group->count : group->count;
+        sprintf(text, "%g", result);
+        table_rewrite(table, first + g, 1, text, delims);
+    }
+    free(text);
+    free(groups);
+    groups_destroy(&gt);
+
+    table_changed(table, -1, -1);
+    index_clear(&table->index);
+    table->visited += sc->end_row - sc->start_row + 1;
+    return 0;
+}
+
+  /*****************************/
+ /******PARALLEL FUNCTIONS*****/
+/*****************************/
+
+/* Number of threads for a per-cell command over the selection
+ * @return: 1 if the selection is smaller than 2*CELL_PARALLEL cells or table has one thread
+ */
+int cells_threads(Selection *sc, Table *table){
+    long long cells = (long long)(sc->end_row - sc->start_row + 1) * (sc->end_col - sc->start_col + 1);
+    int blocks = (sc->end_row - sc->start_row + CELL_BLOCK) / CELL_BLOCK;
+    int threads = table->threads < THREADS_MAX ? table->threads : THREADS_MAX;
+    if (threads > cells / CELL_PARALLEL){
+        threads = cells / CELL_PARALLEL;
+    }
+    if (threads > blocks){
+        threads = blocks;
+    }
+    return threads > 1 ? threads : 1;
+}
+
+/* Thread of per-cell command, rewrites cells of its part or computes partial results of its blocks
+ * @param arg: CellJob
+ */
+void * cell_worker(void *arg){
+    CellJob *job = arg;
+    Table *table = job->table;
+    Selection *sc = &job->sc;
+    if (job->op == OP_SET){
+        for (int i = sc->start_row-1; i < sc->end_row; i++){
+            for (int j = sc->start_col-1; j < sc->end_col; j++){
+                cell_rewrite(&job->arena, &table->rows[i].cells[j], job->text, job->delims);
+            }
+        }
+        return NULL;
+    }
+    for (int i = sc->start_row-1, b = job->block; i < sc->end_row; b++){
+        int end = i + CELL_BLOCK < sc->end_row ? i + CELL_BLOCK : sc->end_row;
+        double sum = 0, num;
+        int counter = 0;
+        for (; i < end; i++){
+            for (int j = sc->start_col-1; j < sc->end_col; j++){
+                Cell *cell = &table->rows[i].cells[j];
+                if (job->op == OP_COUNT){
+                    counter += !cell_empty(cell);
+                } 
+                else if (!cell_to_double(cell, &num)){
+                    sum += num;
+                    counter++;
+                }
+            }
+        }
+        job->sums[b] = sum;
+        job->counts[b] = counter;
+    }
+    return NULL;
+}
+
+/* Run jobs on threads, jobs, which could not get a thread, run in calling thread */
+void cells_run(CellJob *jobs, int n){
+    pthread_t threads[n];
+    bool started[n];
+    for (int t = 1; t < n; t++){
+        started[t] = !pthread_create(&threads[t], NULL, cell_worker, &jobs[t]);
+    }
+    cell_worker(&jobs[0]);
+    for (int t = 1; t < n; t++){
+        if (started[t]){
+            pthread_join(threads[t], NULL);
+        } else {
+            cell_worker(&jobs[t]);
+        }
+    }
+}
+
+/* Split selected rows into parts of whole blocks, one part for each thread
+ * @param job: values shared by all parts
+ */
+void cells_split(Selection *sc, CellJob *jobs, int threads, CellJob job){
+    int blocks = (sc->end_row - sc->start_row + CELL_BLOCK) / CELL_BLOCK;
+    for (int t = 0; t < threads; t++){
+        jobs[t] = job;
+        jobs[t].block = (long)blocks * t / threads;
+        jobs[t].sc.start_row = sc->start_row + jobs[t].block * CELL_BLOCK;
+        int end = sc->start_row - 1 + (long)blocks * (t+1) / threads * CELL_BLOCK;
+        jobs[t].sc.end_row = end < sc->end_row ? end : sc->end_row;
+        arena_init(&jobs[t].arena);
+    }
+}
+
+/* Rewrite all selected cells to the same text (set, clear, use), big selections are 
+ * split between threads, which allocate new texts from their own arenas
+ * Cells are rewritten one by one, if the find index is valid, because it is not shared,
+ * the index is dropped when the selection has more cells than the index
+ * @see: table_rewrite
+ */
+void table_fill(Selection *sc, Table *table, char *text, char *delims){
+    long long cells = (long long)(sc->end_row - sc->start_row + 1) * (sc->end_col - sc->start_col + 1);
+    if (table->index.valid && cells > (long long)table->index.positions){
+        index_clear(&table->index);
+    }
+    int threads = cells_threads(sc, table);
+    table->visited += cells;
+    if (threads == 1 || table->index.valid){
+        for (int i = sc->start_row-1; i < sc->end_row; i++){
+            for (int j = sc->start_col-1; j < sc->end_col; j++){
+                table_rewrite(table, i, j, text, delims);
+            }
+        }
+        return;
+    }
+    CellJob jobs[threads];
+    CellJob job = {.table = table, .op = OP_SET, .sc = *sc, .text = text, .delims = delims};
+    cells_split(sc, jobs, threads, job);
+    cells_run(jobs, threads);
+    for (int t = 0; t < threads; t++){
+        arena_merge(&table->arena, &jobs[t].arena);
+    }
+}
+
+/* Sum (or count) of selected cells computed in blocks of CELL_BLOCK rows, partial results
+ * of blocks are added in order, so the result does not depend on the number of threads
+ * @param op: OP_SUM, OP_AVG (sum of numbers) or OP_COUNT (nonempty cells)
+ * @param sum: sum of numbers
+ * @param counter: number of numbers or nonempty cells
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int cells_reduce(Selection *sc, Table *table, Opcode op, double *sum, int *counter){
+    int blocks = (sc->end_row - sc->start_row + CELL_BLOCK) / CELL_BLOCK;
+    double *sums = malloc(blocks * sizeof(double));
+    int *counts = malloc(blocks * sizeof(int));
+    if (sums == NULL || counts == NULL){
+        free(sums); free(counts);
+        return 1;
+    }
+    int threads = cells_threads(sc, table);
+    table->visited += (long long)(sc->end_row - sc->start_row + 1) * (sc->end_col - sc->start_col + 1);
+    CellJob jobs[threads];
+    CellJob job = {.table = table, .op = op, .sc = *sc, .sums = sums, .counts = counts};
+    cells_split(sc, jobs, threads, job);
+    cells_run(jobs, threads);
+
+    *sum = 0;
+    *counter = 0;
+    for (int b = 0; b < blocks; b++){
+        *sum += sums[b];
+        *counter += counts[b];
+    }
+    free(sums);
+    free(counts);
+    return 0;
+}
+
+  /*****************************/
+ /******PROGRAM FUNCTIONS******/
+/*****************************/
+
+/* Initialize empty program */
+void program_init(Program *prog){
+    prog->size = prog->cap = 0;
+    prog->code = NULL;
+    prog->pool = NULL;
+    prog->pool_size = prog->pool_cap = 0;
+}
+
+/* Free memory used by program */
+void program_destroy(Program *prog){
+    free(prog->code);
+    free(prog->pool);
+    program_init(prog);
+}
+
+/* Append new instruction to the program
+ * @return: pointer to the new instruction or NULL if memory could not be allocated
+ */
+Instr * program_append(Program *prog){
+    if (prog->size == prog->cap){
+        int cap = prog->cap ? prog->cap*2 : 16;
+        Instr *code = realloc(prog->code, cap * sizeof(Instr));
+        if (code == NULL){
+            return NULL;
+        }
+        prog->code = code;
+        prog->cap = cap;
+    }
+    Instr *ins = &prog->code[prog->size++];
+    ins->op = OP_NOP;
+    ins->par[0] = ins->par[1] = ins->par[2] = ins->par[3] = 0;
+    ins->str = -1;
+    return ins;
+}
+
+/* Store string in the program pool, equal strings are stored only once
+ * @param string: string to store
+ * @return: offset of string in the pool, -1 if memory could not be allocated
+ */
+int program_intern(Program *prog, const char *string){
+    for (int pos = 0; pos < prog->pool_size; pos += strlen(prog->pool + pos) + 1){
+        if (!strcmp(prog->pool + pos, string)){
+            return pos;
+        }
+    }
+    int len = strlen(string) + 1;
+    if (prog->pool_size + len > prog->pool_cap){
+        int cap = prog->pool_cap ? prog->pool_cap : 64;
+        while (cap < prog->pool_size + len){
+            cap *= 2;
+        }
+        char *pool = realloc(prog->pool, cap);
+        if (pool == NULL){
+            return -1;
+        }
+        prog->pool = pool;
+        prog->pool_cap = cap;
+    }
+    memcpy(prog->pool + prog->pool_size, string, len);
+    prog->pool_size += len;
+    return prog->pool_size - len;
+}
+
+/* Function used to identify if special char is valid in selection command
+ * @param arg: selection command
+ * @param n: ammound of SELECTION_DELIMITERS (,) before special char
  * @param c: what character should follow after special char
  * @return: 1 if special char was found, the string is modified 
  */
-int special_chars(char *arg, int n, char c, char special){
-    int pos = char_index(SELECTION_DELIM, arg, n);
-    if (arg[pos+1] == special){
-        if (arg[pos+2] != c){
+int special_chars(char *arg, int n, char c, char special){
+    int pos = char_index(SELECTION_DELIM, arg, n);
+    if (arg[pos+1] == special){
+        if (arg[pos+2] != c){
+            return 1;
+        } else {
+            arg[pos+1] = '0';
+        }
+    }   
+    return 0;
+}
+
+/* Compile selection in format [int,int], _ stands for whole row or column
+ * @param arg: command from user, it is modified
+ * @param ins: instruction to fill
+ * @return: 1 if selection is invalid
+ */
+int simple_selection(Instr *ins, char *arg){
+    int par1 = -1, par2 = -1, count; 
+    count = sscanf(arg, "[%d,%d]", &par1, &par2);
+
+    //setting end values
+    if (count != 2){
+        if (special_chars(arg, 0, SELECTION_DELIM, '_')) { //looking for [_,]
+            return 1;
+        } 
+        
+        if (special_chars(arg, 1, ']', '_')) { //looking for [,_]
+            return 1;
+        }
+
+        sscanf(arg, "[%d,%d]", &par1, &par2);
+    } else if (par1 <= 0 || par2 <= 0){
+        return 1;
+    }
+    
+    //start of [_,num] or [num,_] is the first row or column
+    ins->op = OP_SELECT;
+    ins->par[0] = par1 == 0 ? 1 : par1;
+    ins->par[1] = par2 == 0 ? 1 : par2;
+    ins->par[2] = par1;
+    ins->par[3] = par2;
+    return 0;
+}
+
+/*Similiar to simple_selection but uses 4 numbers, - stands for last row or column*/
+int advanced_selection(Instr *ins, char *arg){
+    int par1 = -1, par2 = -1, par3 = -1, par4 = -1, count; 
+    count = sscanf(arg, "[%d,%d,%d,%d]", &par1, &par2, &par3, &par4);
+
+    if (par1 <= 0 || par2 <= 0){
+        return 1;
+    }    
+    
+    if (count != 4){
+        if (special_chars(arg, 2, SELECTION_DELIM, '-')) { // [num,num,-,num]
+            return 1;
+        } 
+        if (special_chars(arg, 3, ']', '-')) { // [num,num,num,-]
+            return 1;
+        }
+        sscanf(arg, "[%d,%d,%d,%d]", &par1, &par2, &par3, &par4);
+        ins->op = par3 == 0 || par4 == 0 ? OP_SELECT : OP_SELECT_END;
+    } else if (par3 > 0 && par4 > 0 && par1 <= par3 && par2 <= par4){
+        ins->op = OP_SELECT;
+    } else {
+        return 1;
+    }
+
+    ins->par[0] = par1;
+    ins->par[1] = par2;
+    ins->par[2] = par3;
+    ins->par[3] = par4;
+    return 0;
+}
+
+/* Compile selection command without numbers ([max], [min], [set], [_])
+ * @param ins: instruction to fill
+ * @param arg: command from user
+ */
+void specify_selection(Instr *ins, char *arg){
+    ins->op = OP_SELECT_NONE;
+    if (!strcmp(arg, "[max]")){
+        ins->op = OP_MAX;
+    } 
+    else if (!strcmp(arg, "[min]")){
+        ins->op = OP_MIN;
+    } 
+    else if (!strcmp(arg, "[set]")){
+        ins->op = OP_SEL_STORE;
+    }
+    else if (!strcmp(arg, "[_]")){
+        ins->op = OP_SEL_LOAD;
+    }
+}
+
+/* Compile search selection ([find STR], [contains STR], [prefix STR], [regex RE]),
+ * pattern is the rest of command up to the closing ], so it can contain spaces and commas
+ * @param prog: program, which stores the pattern
+ * @param arg: command from user
+ * @return: -1 if memory could not be allocated, 0 if it was compiled,
+ *          1 if it is not a search selection
+ */
+int search_selection(Program *prog, Instr *ins, char *arg){
+    const char *names[] = {"[find ", "[contains ", "[prefix ", "[regex "};
+    const Opcode ops[] = {OP_FIND, OP_CONTAINS, OP_PREFIX, OP_REGEX};
+    for (int k = 0; k < 4; k++){
+        int n = strlen(names[k]);
+        if (strncmp(arg, names[k], n)){
+            continue;
+        }
+        int len = strlen(arg + n);
+        if (len == 0 || arg[n + len - 1] != ']'){
+            ins->op = OP_SEL_ERROR;
+            return 0;
+        }
+        arg[n + len - 1] = '\0'; //remove ] from the end
+        ins->op = len == 1 ? OP_SELECT_NONE : ops[k]; //empty pattern
+        Matcher m;
+        if (ins->op == OP_REGEX && matcher_init(&m, OP_REGEX, arg + n)){
+            ins->op = OP_SEL_ERROR;
+            return 0;
+        }
+        if (ins->op == OP_REGEX){
+            matcher_destroy(&m);
+        }
+        if (ins->op != OP_SELECT_NONE && (ins->str = program_intern(prog, arg + n)) < 0){
+            return -1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/* Check bounds of compiled [r,c] or [r1,c1,r2,c2] selection, 0 stands for _ or -
+ * @return: 1 if a bound is out of range
+ */
+int selection_bounds(Instr *ins){
+    int last = ins->op == OP_SELECT_END; //[_,_,r2,c2] has both ends
+    return ins->par[0] <= 0 || ins->par[1] <= 0 || ins->par[2] < last || ins->par[3] < last;
+}
+
+/* Compile selection command, invalid selection becomes OP_SEL_ERROR
+ * @param arg: command from user, it is modified
+ * @return: 1 if memory could not be allocated
+ */
+int compile_selection(Program *prog, Instr *ins, char *arg){
+    int error = search_selection(prog, ins, arg);
+    if (error <= 0){
+        return error < 0;
+    }
+    int counter = char_in_string(SELECTION_DELIM, arg); //number of commas 
+
+    if (counter == 0){
+        specify_selection(ins, arg); //[max]
+        return 0;
+    } else if (counter == 1){
+        error = simple_selection(ins, arg); //[int,int]
+    } else if (counter == 3){
+        error = advanced_selection(ins, arg); //[int,int,int,int]
+    } else {
+        error = 1;
+    }
+
+    if (error || selection_bounds(ins)){
+        ins->op = OP_SEL_ERROR;
+    }
+    return 0;
+}
+
+/* Execute selection instruction
+ * @param sc: selection struct
+ * @param ins: selection instruction
+ * @param table: table struct
+ * @param out: destination of debug output
+ */
+void set_selection(Selection *sc, Selection *tmp_sc, Instr *ins, Program *prog, Table *table,
+                   FILE *out){
+    switch (ins->op){
+        case OP_SELECT:
+            sc->start_row = ins->par[0];
+            sc->start_col = ins->par[1];
+            //fall through
+        case OP_SELECT_END:
+            sc->end_row = ins->par[2] == 0 ? table->size : ins->par[2];
+            sc->end_col = ins->par[3] == 0 ? table->rows[0].size : ins->par[3];
+            break;
+        case OP_MAX:
+            m_selection(sc, table, "max");
+            break;
+        case OP_MIN:
+            m_selection(sc, table, "min");
+            break;
+        case OP_FIND: case OP_CONTAINS: case OP_PREFIX: case OP_REGEX:
+            find_selection(sc, table, ins->op, prog->pool + ins->str);
+            break;
+        case OP_SEL_STORE:
+            tmp_selection_set(sc, tmp_sc);
+            break;
+        case OP_SEL_LOAD:
+            tmp_selection_use(sc, tmp_sc);
+            break;
+        default:
+            break;
+    }
+    check_table_size(sc, table);
+    table_parse(table, sc->start_row, sc->end_row);
+    
+    /*debug mode*/
+    fprintf(out, "Selection:\n");
+    print_selection(sc, table, out);
+    fputc('\n', out); fputc('\n', out);
+}
+
+/* Column part of edit_tstruc for one row
+ * @param op: OP_ICOL, OP_ACOL or OP_DCOL
+ * @param sc: selected columns
+ */
+void edit_row(Arena *arena, Row *row, Opcode op, Selection *sc){
+    int cols = sc->end_col - sc->start_col + 1;
+    if (op == OP_ICOL){
+        row_insert(arena, row, sc->start_col-1, cols);
+    }
+    else if (op == OP_ACOL){
+        row_insert(arena, row, sc->end_col, cols);
+    }
+    else if (op == OP_DCOL){
+        row_erase(arena, row, sc->start_col-1, cols);
+    }
+}
+
+/* Functions for editing structure of the whole table
+ * irow (arow) inserts one row above (below) the selection for every selected row, 
+ * drow deletes the selected rows, icol, acol and dcol do the same with columns 
+ * of all rows. Every command moves each array only once
+ */
+int edit_tstruc(Selection *sc, Opcode op, Table *table, char *delims){
+    int rows = sc->end_row - sc->start_row + 1;
+    int cols = sc->end_col - sc->start_col + 1;
+    int width = table->size ? table->rows[0].size : 0;
+    if (op >= OP_IROW && op <= OP_DROW){
+        table->visited += (long long)rows * width;
+    } else if (op >= OP_ICOL && op <= OP_DCOL){
+        table->visited += (long long)table->size * cols;
+    }
+    switch (op){
+        case OP_IROW:
+            table_insert(table, sc->start_row-1, rows);
+            index_shift(&table->index, false, sc->start_row-1, rows);
+            break;
+        case OP_AROW:
+            table_insert(table, sc->end_row, rows);
+            index_shift(&table->index, false, sc->end_row, rows);
+            break;
+        case OP_DROW:
+            table_erase(table, sc->start_row-1, rows);
+            index_shift(&table->index, false, sc->start_row-1, -rows);
+            break;
+        case OP_ICOL: case OP_ACOL: case OP_DCOL:
+            for (int i = 0; i < table->size; i++){
+                edit_row(&table->arena, &table->rows[i], op, sc);
+            }
+            index_shift(&table->index, true, op == OP_ACOL ? sc->end_col : sc->start_col-1, 
+                        op == OP_DCOL ? -cols : cols);
+            break;
+        case OP_CLEAR:
+            table_fill(sc, table, "\0", delims);
+            table_changed(table, sc->start_col-1, sc->end_col-1);
+            return 0;
+        default:
+            return 0;
+    }
+    table_changed(table, -1, -1);
+    return 0;
+}
+
+/* Edits temporary variables based on user command */
+int edit_variables(Selection *sc, Table *table, Temporary *tmp_vars, Instr *ins, char *delims){
+    int var = ins->par[0];
+
+    if (ins->op == OP_DEF){
+        table->visited++;
+        int len = table->rows[sc->end_row-1].cells[sc->end_col-1].size;
+        char text[len+1];
+        get_cell_text(&table->rows[sc->end_row-1].cells[sc->end_col-1], text);
+        cell_rewrite(NULL, &tmp_vars->variables[var], text, delims); 
+    }
+    else if (ins->op == OP_USE){
+        int len = tmp_vars->variables[var].size;
+        char text[len+1];
+        get_cell_text(&tmp_vars->variables[var], text);
+        table_fill(sc, table, text, delims);
+        table_changed(table, sc->start_col-1, sc->end_col-1);
+    } 
+    else if (ins->op == OP_INC){
+        double num;
+        char text[50];
+        if (tmp_vars->variables[var].text != NULL){
+            if (sscanf(tmp_vars->variables[var].text, "%lf", &num)){
+                num++;
+                sprintf(text, "%g", num);
+            } else {
+                num = 1.0;
+                sprintf(text, "%g", num);
+            }
+        } else {
+            num = 1.0;
+            sprintf(text, "%g", num);
+        }
+
+        cell_rewrite(NULL, &tmp_vars->variables[var], text, delims);
+    }
+
+    return 0;
+}
+
+/* Check if cell [par1,par2] from instruction operand lies in the table
+ * @param par: operand, 0 if it was not in format [int,int]
+ * @return: 1 if cell is outside of table
+ */
+int check_target(Table *table, int *par){
+    if (par[0] <= 0 || par[1] <= 0 || par[0] > table->size || par[1] > table->rows[0].size ){
+        return 1;
+    }
+    return 0;
+}
+
+/* Compute sum, avg, count or len of selection
+ * Numbers are added in row-major order in blocks of CELL_BLOCK rows, so the result
+ * does not depend on the kernels and threads
+ * @param op: OP_SUM, OP_AVG, OP_COUNT or OP_LEN
+ * @param result: computed value
+ * @return: 0 if successful, 1 if memory could not be allocated
+ */
+int aggregate(Selection *sc, Table *table, Opcode op, double *result){
+    if (op == OP_LEN){ //only the last cell of selection counts
+        Cell *cell = &table->rows[sc->end_row-1].cells[sc->end_col-1];
+        *result = cell_empty(cell) ? 0 : cell->size;
+        table->visited++;
+        return 0;
+    }
+
+    if (op == OP_COUNT){
+        int counter = 0;
+        if (table->columns.enabled){
+            if (columns_reserve(&table->columns, sc->end_col))
+                return 1;
+            for (int j = sc->start_col-1; j < sc->end_col; j++){
+                Column *col = column_get(table, j);
+                if (col == NULL)
+                    return 1;
+                counter += kernels_get()->count(col->filled + sc->start_row-1, 
+                                                sc->end_row - sc->start_row + 1);
+                table->visited += sc->end_row - sc->start_row + 1;
+            }
+        } else {
+            double sum;
+            if (cells_reduce(sc, table, op, &sum, &counter))
+                return 1;
+        }
+        *result = counter;
+        return 0;
+    }
+
+    double sum;
+    int counter;
+    if (table->columns.enabled){
+        Numbers nums;
+        if (selection_numbers(sc, table, &nums)){
+            return 1;
+        }
+        int cols = sc->end_col - sc->start_col + 1;
+        sum = sum_blocks(nums.vals, nums.ok, nums.n, CELL_BLOCK * cols, &counter);
+        numbers_free(&nums);
+        table->visited += nums.n;
+    } 
+    else if (cells_reduce(sc, table, op, &sum, &counter)){
+        return 1;
+    }
+    *result = op == OP_AVG ? sum / counter : sum;
+    return 0;
+}
+
+/* Functions for editing data in table 
+ * @param ins: instruction with [r,c] target or string to set
+ */
+int edit_tdata(Selection *sc, Table *table, Instr *ins, Program *prog, char *delims){
+    double temp_value = 0;
+    char sum[50];
+    int *target = ins->par;
+
+    if (ins->op == OP_SUM || ins->op == OP_AVG || ins->op == OP_COUNT || ins->op == OP_LEN){
+        if (check_target(table, target) || aggregate(sc, table, ins->op, &temp_value)){
+            return 1;
+        }
+        sprintf(sum, "%g", temp_value);
+        table_rewrite(table, target[0]-1, target[1]-1, sum, delims);
+        table_changed(table, target[1]-1, target[1]-1);
+        return 0;
+    }
+
+    if (ins->op == OP_SET){
+        table_fill(sc, table, prog->pool + ins->str, delims);
+        table_changed(table, sc->start_col-1, sc->end_col-1);
+    }
+    else if (ins->op == OP_SWAP){
+        for (int i = sc->start_row-1; i < sc->end_row; i++){
+            for (int j = sc->start_col-1; j < sc->end_col; j++){
+                if (check_target(table, target)){
+                    return 1;
+                }
+                table_swap(table, i, j, target[0]-1, target[1]-1);
+                table->visited += 2;
+            }
+        }
+        table_changed(table, -1, -1);
+    }
+
+    return 0;
+}
+
+/* Parse unparsed rows (-l), which the instruction reads or changes, before it is executed
+ * Selections parse their rows when they are printed (set_selection)
+ * @param sc: selection before the instruction
+ */
+void table_touch(Table *table, Instr *ins, Selection *sc){
+    switch (ins->op){
+        case OP_SELECT: case OP_SELECT_END: case OP_SELECT_NONE: case OP_SEL_STORE: 
+        case OP_SEL_LOAD: case OP_IROW: case OP_AROW: case OP_DROW: case OP_INC: case OP_NOP:
+        case OP_SEL_ERROR: case OP_CMD_ERROR:
+            return;
+        case OP_ICOL: case OP_ACOL: case OP_DCOL:
+            table_parse(table, 1, table->size);
+            return;
+        case OP_SWAP: case OP_SUM: case OP_AVG: case OP_COUNT: case OP_LEN: //target cell
+            table_parse(table, ins->par[0], ins->par[0]);
+            //fall through
+        default:
+            table_parse(table, sc->start_row, sc->end_row);
+    }
+}
+
+  /*****************************/
+ /******COMPILER FUNCTIONS*****/
+/*****************************/
+
+/* Opcode of command without parameters
+ * @return: opcode or OP_NOP for unknown command
+ */
+Opcode struc_opcode(char *arg){
+    const char *names[] = {"irow", "arow", "drow", "icol", "acol", "dcol", "clear", "sort"};
+    const Opcode ops[] = {OP_IROW, OP_AROW, OP_DROW, OP_ICOL, OP_ACOL, OP_DCOL, OP_CLEAR, OP_SORT};
+    for (int i = 0; i < 8; i++){
+        if (!strcmp(arg, names[i])){
+            return ops[i];
+        }
+    }
+    return OP_NOP;
+}
+
+/* Compile command with parameter (set STR, sum [r,c], def _n, ...)
+ * Command which can not be separated becomes OP_CMD_ERROR
+ * @param curr_cmnd: command from user
+ * @return: 1 if memory could not be allocated
+ */
+int compile_command(Program *prog, Instr *ins, char *curr_cmnd){
+    int len = strlen(curr_cmnd) + 1;
+    char arg[len], param[len];
+
+    if (!strncmp(curr_cmnd, "group ", 6)){ //group sum|avg|count COL
+        const char *names[] = {"sum", "avg", "count"};
+        const Opcode ops[] = {OP_SUM, OP_AVG, OP_COUNT};
+        int col, n = 0;
+        ins->op = OP_CMD_ERROR;
+        if (sscanf(curr_cmnd, "group %s %d %n", param, &col, &n) != 2 || curr_cmnd[n] || col <= 0){
+            return 0;
+        }
+        for (int i = 0; i < 3; i++){
+            if (!strcmp(param, names[i])){
+                ins->op = OP_GROUP;
+                ins->par[0] = ops[i];
+                ins->par[1] = col;
+            }
+        }
+        return 0;
+    }
+
+    if (!strncmp(curr_cmnd, "sort ", 5)){ //sort [asc|desc] [num|lex]
+        int pos = 5, n;
+        ins->op = OP_SORT;
+        while (sscanf(curr_cmnd + pos, "%s%n", param, &n) == 1){
+            pos += n;
+            if (!strcmp(param, "asc") || !strcmp(param, "desc")){
+                ins->par[0] = !strcmp(param, "desc");
+            } 
+            else if (!strcmp(param, "lex") || !strcmp(param, "num")){
+                ins->par[1] = !strcmp(param, "num");
+            } 
+            else {
+                ins->op = OP_CMD_ERROR;
+                return 0;
+            }
+        }
+        return 0;
+    }
+
+    if (char_in_string('_', curr_cmnd)){
+        int var;
+        if (sscanf(curr_cmnd, "%s _%s", arg, param) != 2 || sscanf(param, "%d", &var) != 1 ||
+            var < 0 || var >= TEMPORARY_MAX){
+            ins->op = OP_CMD_ERROR;
+            return 0;
+        }
+        ins->par[0] = var;
+        if (!strcmp(arg, "def")){
+            ins->op = OP_DEF;
+        } else if (!strcmp(arg, "use")){
+            ins->op = OP_USE;
+        } else if (!strcmp(arg, "inc")){
+            ins->op = OP_INC;
+        }
+        return 0;
+    }
+
+    if (sscanf(curr_cmnd, "%s %s", arg, param) != 2){
+        ins->op = OP_CMD_ERROR;
+        return 0;
+    }
+    if (!strcmp(arg, "set")){
+        ins->op = OP_SET;
+        return (ins->str = program_intern(prog, param)) < 0;
+    }
+
+    const char *names[] = {"swap", "sum", "avg", "count", "len"};
+    const Opcode ops[] = {OP_SWAP, OP_SUM, OP_AVG, OP_COUNT, OP_LEN};
+    for (int i = 0; i < 5; i++){
+        if (!strcmp(arg, names[i])){
+            ins->op = ops[i];
+            if (sscanf(param, "[%d,%d]", &ins->par[0], &ins->par[1]) != 2 ||
+                ins->par[0] <= 0 || ins->par[1] <= 0){
+                ins->par[0] = ins->par[1] = 0; //fails check_target
+            }
+        }
+    }
+    return 0;
+}
+
+/* Compile command sequence into program - separate commands, identify them 
+ * and extract their parameters, so they are parsed only once
+ * @param cmd_seq: command sequence from user, it is modified
+ * @param prog: empty program to fill
+ * @return: 1 if memory could not be allocated
+ */
+int parse_commands(char *cmd_seq, Program *prog){
+    char *curr_cmnd = strtok(cmd_seq, CMD_DELIM);
+    while (curr_cmnd != NULL){
+        Instr *ins = program_append(prog);
+        if (ins == NULL){
             return 1;
+        }
+        if (curr_cmnd[0] == '['){
+            if (compile_selection(prog, ins, curr_cmnd)){
+                return 1;
+            }
+        } 
+        else if (!char_in_string(' ', curr_cmnd)){
+            ins->op = struc_opcode(curr_cmnd);
+        }
+        else if (compile_command(prog, ins, curr_cmnd)){
+            return 1;
+        }
+        curr_cmnd = strtok(NULL, CMD_DELIM);
+    }
+    return 0;
+}
+
+  /*****************************/
+ /******PROFILE FUNCTIONS******/
+/*****************************/
+
+//Reports of files processed by batch workers are not interleaved
+pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Set default values to an empty profile */
+void profile_init(Profile *prof){
+    prof->size = prof->cap = 0;
+    prof->entries = NULL;
+}
+
+/* Start profiled phase, current counters of the table are remembered */
+void profile_begin(Profile *prof, Table *table){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    prof->start = ts.tv_sec + ts.tv_nsec / 1e9;
+    prof->cells = table->visited;
+    prof->allocs = table->arena.allocs;
+    prof->copied = table->arena.copied;
+}
+
+/* End profiled phase and add its entry to profile, entry is dropped if memory is short
+ * @param name: name of the phase
+ * @param cells: cells visited by the phase, -1 if they were counted by commands
+ */
+void profile_end(Profile *prof, Table *table, const char *name, long long cells){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (prof->size == prof->cap){
+        int cap = prof->cap ? prof->cap * 2 : 16;
+        ProfileEntry *resized = realloc(prof->entries, cap * sizeof(ProfileEntry));
+        if (resized == NULL){
+            return;
+        }
+        prof->entries = resized;
+        prof->cap = cap;
+    }
+    ProfileEntry *e = &prof->entries[prof->size++];
+    snprintf(e->name, PROFILE_NAME, "%s", name);
+    e->time = ts.tv_sec + ts.tv_nsec / 1e9 - prof->start;
+    e->cells = cells >= 0 ? cells : table->visited - prof->cells;
+    e->allocs = table->arena.allocs - prof->allocs;
+    e->copied = table->arena.copied - prof->copied;
+}
+
+/* Number of cells of the table */
+long long table_cells(Table *table){
+    long long cells = 0;
+    for (int i = 0; i < table->size; i++){
+        cells += table->rows[i].size;
+    }
+    return cells;
+}
+
+/* Write command of an instruction in the form of the command sequence
+ * @param k: index of instruction in program
+ * @param buf: destination of PROFILE_NAME characters
+ */
+void instr_describe(Program *prog, int k, char *buf){
+    Instr *ins = &prog->code[k];
+    const char *str = ins->str >= 0 ? prog->pool + ins->str : "";
+    int *par = ins->par;
+    char bounds[4][12];
+    for (int i = 0; i < 4; i++){
+        if (par[i]){
+            sprintf(bounds[i], "%d", par[i]);
         } else {
-            arg[pos+1] = '0';
+            strcpy(bounds[i], "-");
         }
-    }   
+    }
+    int n = snprintf(buf, PROFILE_NAME, "%d: ", k+1);
+    char *dst = buf + n;
+    size_t size = PROFILE_NAME - n;
+    switch (ins->op){
+        case OP_SELECT:
+            snprintf(dst, size, "[%s,%s,%s,%s]", bounds[0], bounds[1], bounds[2], bounds[3]);
+            break;
+        case OP_SELECT_END:
+            snprintf(dst, size, "[_,_,%s,%s]", bounds[2], bounds[3]);
+            break;
+        case OP_SELECT_NONE: snprintf(dst, size, "[]"); break;
+        case OP_MAX: snprintf(dst, size, "[max]"); break;
+        case OP_MIN: snprintf(dst, size, "[min]"); break;
+        case OP_FIND: snprintf(dst, size, "[find %s]", str); break;
+        case OP_CONTAINS: snprintf(dst, size, "[contains %s]", str); break;
+        case OP_PREFIX: snprintf(dst, size, "[prefix %s]", str); break;
+        case OP_REGEX: snprintf(dst, size, "[regex %s]", str); break;
+        case OP_SEL_STORE: snprintf(dst, size, "[set]"); break;
+        case OP_SEL_LOAD: snprintf(dst, size, "[_]"); break;
+        case OP_IROW: snprintf(dst, size, "irow"); break;
+        case OP_AROW: snprintf(dst, size, "arow"); break;
+        case OP_DROW: snprintf(dst, size, "drow"); break;
+        case OP_ICOL: snprintf(dst, size, "icol"); break;
+        case OP_ACOL: snprintf(dst, size, "acol"); break;
+        case OP_DCOL: snprintf(dst, size, "dcol"); break;
+        case OP_CLEAR: snprintf(dst, size, "clear"); break;
+        case OP_SORT:
+            snprintf(dst, size, "sort %s %s", par[0] ? "desc" : "asc", par[1] ? "num" : "lex");
+            break;
+        case OP_GROUP:
+            snprintf(dst, size, "group %s %d", par[0] == OP_SUM ? "sum" : 
+                     par[0] == OP_AVG ? "avg" : "count", par[1]);
+            break;
+        case OP_SET: snprintf(dst, size, "set %s", str); break;
+        case OP_SWAP: snprintf(dst, size, "swap [%d,%d]", par[0], par[1]); break;
+        case OP_SUM: snprintf(dst, size, "sum [%d,%d]", par[0], par[1]); break;
+        case OP_AVG: snprintf(dst, size, "avg [%d,%d]", par[0], par[1]); break;
+        case OP_COUNT: snprintf(dst, size, "count [%d,%d]", par[0], par[1]); break;
+        case OP_LEN: snprintf(dst, size, "len [%d,%d]", par[0], par[1]); break;
+        case OP_DEF: snprintf(dst, size, "def _%d", par[0]); break;
+        case OP_USE: snprintf(dst, size, "use _%d", par[0]); break;
+        case OP_INC: snprintf(dst, size, "inc _%d", par[0]); break;
+        default: snprintf(dst, size, "nop"); break;
+    }
+}
+
+/* Write string as JSON string literal */
+void json_string(FILE *dst, const char *str){
+    fputc('"', dst);
+    for (; *str; str++){
+        unsigned char c = *str;
+        if (c == '"' || c == '\\'){
+            fprintf(dst, "\\%c", c);
+        } else if (c < 0x20){
+            fprintf(dst, "\\u%04x", c);
+        } else {
+            fputc(c, dst);
+        }
+    }
+    fputc('"', dst);
+}
+
+int profile_compare(const void *a, const void *b){
+    const ProfileEntry *x = a, *y = b;
+    return (x->time < y->time) - (x->time > y->time);
+}
+
+/* Write profile of one file, to stderr as a table of phases sorted by time,
+ * or appended to JSON file as one object per line with phases in order of execution
+ * @param path: processed file
+ * @param dest: "-" for stderr, otherwise path of JSON file
+ * @return: 0 if successful, 1 if profile could not be written
+ */
+int profile_report(Profile *prof, const char *path, const char *dest){
+    double total = 0;
+    for (int k = 0; k < prof->size; k++){
+        total += prof->entries[k].time;
+    }
+    pthread_mutex_lock(&profile_lock);
+    int error = 0;
+    if (!strcmp(dest, "-")){
+        ProfileEntry *sorted = malloc(prof->size * sizeof(ProfileEntry) + 1);
+        if (sorted != NULL){
+            memcpy(sorted, prof->entries, prof->size * sizeof(ProfileEntry));
+            qsort(sorted, prof->size, sizeof(ProfileEntry), profile_compare);
+            fprintf(stderr, "profile of %s (%.6f s):\n", path, total);
+            fprintf(stderr, "%12s %6s %12s %10s %12s  %s\n", 
+                    "time [s]", "%", "cells", "allocs", "copied [B]", "phase");
+            for (int k = 0; k < prof->size; k++){
+                ProfileEntry *e = &sorted[k];
+                fprintf(stderr, "%12.6f %6.1f %12lld %10lld %12lld  %s\n", e->time, 
+                        total > 0 ? 100 * e->time / total : 0.0, e->cells, e->allocs, e->copied, e->name);
+            }
+            free(sorted);
+        }
+        error = sorted == NULL;
+    } else {
+        FILE *f = fopen(dest, "a");
+        if (f != NULL){
+            fprintf(f, "{\"file\": ");
+            json_string(f, path);
+            fprintf(f, ", \"total_s\": %.9f, \"phases\": [", total);
+            for (int k = 0; k < prof->size; k++){
+                ProfileEntry *e = &prof->entries[k];
+                fprintf(f, "%s{\"name\": ", k ? ", " : "");
+                json_string(f, e->name);
+                fprintf(f, ", \"time_s\": %.9f, \"cells\": %lld, \"allocs\": %lld, \"copied\": %lld}", 
+                        e->time, e->cells, e->allocs, e->copied);
+            }
+            fprintf(f, "]}\n");
+        }
+        error = f == NULL || fclose(f);
+    }
+    pthread_mutex_unlock(&profile_lock);
+    return error;
+}
+
+/* Free entries of profile */
+void profile_destroy(Profile *prof){
+    free(prof->entries);
+    profile_init(prof);
+}
+
+/* Execute compiled program on a table
+ * @param out: destination of debug output and error messages
+ * @return: 0 if successful, 1 if invalid command was reached
+ */
+int run_program(Program *prog, Selection *sc, Selection *tmp_sc, Table *table, 
+                Temporary *tmp_vars, char *delims, FILE *out){
+    for (int k = 0; k < prog->size; k++){
+        Instr *ins = &prog->code[k];
+        if (table->profile != NULL){
+            profile_begin(table->profile, table);
+        }
+        table_touch(table, ins, sc);
+        switch (ins->op){
+            case OP_SELECT: case OP_SELECT_END: case OP_SELECT_NONE: 
+            case OP_SEL_STORE: case OP_SEL_LOAD:
+                set_selection(sc, tmp_sc, ins, prog, table, out);
+                break;
+            case OP_MAX: case OP_MIN: case OP_FIND: case OP_CONTAINS: case OP_PREFIX: 
+            case OP_REGEX: //search the current selection
+                check_table_size(sc, table);
+                set_selection(sc, tmp_sc, ins, prog, table, out);
+                break;
+            case OP_IROW: case OP_AROW: case OP_DROW: case OP_ICOL: 
+            case OP_ACOL: case OP_DCOL: case OP_NOP:
+                edit_tstruc(sc, ins->op, table, delims);
+                break;
+            case OP_CLEAR: //drow and dcol could leave the selection outside of the table
+                check_table_size(sc, table);
+                edit_tstruc(sc, ins->op, table, delims);
+                break;
+            case OP_SORT:
+                check_table_size(sc, table);
+                if (sort_selection(sc, table, ins)){
+                    fprintf(out, "Nedostatok pamate\n");
+                    return 1;
+                }
+                break;
+            case OP_GROUP:
+                check_table_size(sc, table);
+                if (group_selection(sc, table, ins, delims)){
+                    fprintf(out, "Nedostatok pamate\n");
+                    return 1;
+                }
+                break;
+            case OP_DEF: case OP_USE: case OP_INC:
+                check_table_size(sc, table);
+                edit_variables(sc, table, tmp_vars, ins, delims);
+                break;
+            case OP_SET: case OP_SWAP: case OP_SUM: case OP_AVG: case OP_COUNT: case OP_LEN:
+                check_table_size(sc, table);
+                if (edit_tdata(sc, table, ins, prog, delims)){ //parameter was not valid
+                    fprintf(out, "Chybne zadane prikazy\n");
+                    return 1;
+                }
+                break;
+            case OP_SEL_ERROR:
+                fprintf(out, "Chybne argumenty selekcie\n");
+                return 1;
+            case OP_CMD_ERROR:
+                fprintf(out, "Chybne zadane prikazy\n");
+                return 1;
+        }
+        if (table->profile != NULL){
+            char name[PROFILE_NAME];
+            instr_describe(prog, k, name);
+            profile_end(table->profile, table, name, -1);
+        }
+    }
+    return 0;
+}
+
+/* Check operands of an instruction loaded from cache, they have to be ones
+ * the compiler can produce
+ * @return: 1 if the instruction is damaged
+ */
+int instr_damaged(Program *prog, Instr *ins){
+    bool string = false; //string operand is required
+    int *par = ins->par;
+    switch (ins->op){
+        case OP_SELECT: case OP_SELECT_END:
+            if (selection_bounds(ins)){
+                return 1;
+            }
+            break;
+        case OP_FIND: case OP_CONTAINS: case OP_PREFIX: case OP_REGEX: case OP_SET:
+            string = true;
+            break;
+        case OP_SORT:
+            if ((par[0] != 0 && par[0] != 1) || (par[1] != 0 && par[1] != 1)){
+                return 1;
+            }
+            break;
+        case OP_GROUP:
+            if ((par[0] != OP_SUM && par[0] != OP_AVG && par[0] != OP_COUNT) || par[1] <= 0){
+                return 1;
+            }
+            break;
+        case OP_SWAP: case OP_SUM: case OP_AVG: case OP_COUNT: case OP_LEN:
+            if (par[0] < 0 || par[1] < 0){ //0 is invalid target, it fails check_target
+                return 1;
+            }
+            break;
+        case OP_DEF: case OP_USE: case OP_INC:
+            if (par[0] < 0 || par[0] >= TEMPORARY_MAX){
+                return 1;
+            }
+            break;
+        default:
+            if (ins->op < OP_NOP || ins->op > OP_CMD_ERROR){
+                return 1;
+            }
+    }
+    if (!string){
+        return ins->str != -1;
+    }
+    return ins->str < 0 || ins->str >= prog->pool_size ||
+           memchr(prog->pool + ins->str, '\0', prog->pool_size - ins->str) == NULL;
+}
+
+/* Load compiled program from cache file, if it was compiled from the same command sequence
+ * File contains PROGRAM_MAGIC, sizeof(Instr), source, instructions and string pool
+ * @param path: cache file
+ * @param source: command sequence from user
+ * @return: 0 if program was loaded, 1 otherwise
+ */
+int program_load(Program *prog, const char *path, const char *source){
+    FILE *f = fopen(path, "rb");
+    if (f == NULL){
+        return 1;
+    }
+    char magic[sizeof(PROGRAM_MAGIC)];
+    int header[4]; //sizeof(Instr), source length, instructions, pool size
+    int error = fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+                memcmp(magic, PROGRAM_MAGIC, sizeof(magic)) ||
+                fread(header, sizeof(int), 4, f) != 4 || header[0] != (int)sizeof(Instr) ||
+                header[1] != (int)strlen(source) || header[2] < 0 || header[3] < 0 ||
+                header[3] == INT_MAX;
+    struct stat st; //counts must match size of file, so damaged counts are not allocated
+    error = error || fstat(fileno(f), &st) ||
+            st.st_size != (off_t)(sizeof(magic) + sizeof(header) + (size_t)header[1] +
+                                  (size_t)header[2] * sizeof(Instr) + (size_t)header[3]);
+    if (!error){
+        char stored[header[1]+1];
+        prog->code = malloc(header[2] * sizeof(Instr) + 1);
+        prog->pool = malloc(header[3] + 1);
+        error = prog->code == NULL || prog->pool == NULL ||
+                fread(stored, 1, header[1], f) != (size_t)header[1] ||
+                memcmp(stored, source, header[1]) ||
+                fread(prog->code, sizeof(Instr), header[2], f) != (size_t)header[2] ||
+                fread(prog->pool, 1, header[3], f) != (size_t)header[3];
+        prog->size = prog->cap = header[2];
+        prog->pool_size = prog->pool_cap = header[3];
+    }
+    for (int k = 0; !error && k < prog->size; k++){ //reject damaged files
+        error = instr_damaged(prog, &prog->code[k]);
+    }
+    fclose(f);
+    if (error){
+        program_destroy(prog);
+    }
+    return error;
+}
+
+/* Store compiled program to cache file
+ * @return: 0 if successful, 1 if file could not be written
+ */
+int program_save(Program *prog, const char *path, const char *source){
+    FILE *f = fopen(path, "wb");
+    if (f == NULL){
+        return 1;
+    }
+    int header[4] = {sizeof(Instr), strlen(source), prog->size, prog->pool_size};
+    fwrite(PROGRAM_MAGIC, 1, sizeof(PROGRAM_MAGIC), f);
+    fwrite(header, sizeof(int), 4, f);
+    fwrite(source, 1, header[1], f);
+    fwrite(prog->code, sizeof(Instr), prog->size, f);
+    if (prog->pool_size > 0){ //pool is NULL if there are no strings
+        fwrite(prog->pool, 1, prog->pool_size, f);
+    }
+    return fclose(f) != 0;
+}
+
+/* Get program for command sequence from cache or compile it
+ * @param cache: path to cache file or NULL
+ * @return: 1 if memory could not be allocated
+ */
+int compile_program(Program *prog, char *cmd_seq, const char *cache){
+    program_init(prog);
+    if (cache != NULL && !program_load(prog, cache, cmd_seq)){
+        return 0;
+    }
+    char source[strlen(cmd_seq)+1];
+    strcpy(source, cmd_seq); //strtok modifies command sequence
+    if (parse_commands(cmd_seq, prog)){
+        program_destroy(prog);
+        return 1;
+    }
+    if (cache != NULL && program_save(prog, cache, source)){
+        fprintf(stderr, "Nepodarilo sa ulozit prelozeny program\n");
+    }
+    return 0;
+}
+
+/* Remove excess (most right empty) colums from table, these are the columns after 
+ * the last nonempty cell of all rows. Unparsed rows (-l) are only shortened
+ */
+void excess_columns(Table *table){
+    if (table->size == 0){
+        return;
+    }
+    int width = table->rows[0].size, used = 0;
+    const char *end = table->map + table->map_size;
+    //rows are checked only until the last column has a nonempty cell
+    for (int i = 0; i < table->size && used < width; i++){
+        Row *row = &table->rows[i];
+        if (row->line != NULL){
+            int w = table->snapshot ? record_width(table, row) : line_width(row, table->delim, end);
+            used = w > used ? w : used;
+            continue;
+        }
+        for (int j = row->size; j > used; j--){
+            if (!cell_empty(&row->cells[j-1])){
+                used = j;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < table->size; i++){
+        Row *row = &table->rows[i];
+        if (row->line != NULL){
+            row->size = used;
+        } else {
+            row_erase(&table->arena, row, used, row->size - used);
+        }
+    }
+}
+
+  /*****************************/
+ /******STREAM FUNCTIONS*******/
+/*****************************/
+
+//State of streaming execution
+typedef struct {
+    Program *prog;
+    char *delims;
+    FILE *out;
+    int mode; //STREAM_SCAN, STREAM_SELECTION, STREAM_EMPTY or STREAM_PRINT
+    int upto; //number of instructions applied to each row
+    int rows; //number of rows found by STREAM_SCAN
+    int width; //width of the widest input row, found by STREAM_SCAN
+    int printed; //number of columns left by excess_columns
+    bool *filled; //columns of the result with nonempty cell (STREAM_EMPTY)
+    Writer *writer; //output of the result (STREAM_PRINT)
+} Stream;
+
+/* Selection of columns in every row, rows of selection are not used
+ * Selection over all rows is marked by end_row 0, other selections are not row-local
+ * @param ins: selection instruction
+ * @param width: width of rows before the selection, _ and - are resolved to it
+ * @return: 1 if selection can not be streamed
+ */
+int stream_select(Instr *ins, Selection *sc, Selection *tmp_sc, int width){
+    switch (ins->op){
+        case OP_SELECT:
+            if (ins->par[0] != 1 || ins->par[2] != 0){
+                return 1;
+            }
+            sc->start_row = 1;
+            sc->end_row = 0;
+            sc->start_col = ins->par[1];
+            sc->end_col = ins->par[3] == 0 ? width : ins->par[3];
+            return 0;
+        case OP_SELECT_NONE:
+            return 0;
+        case OP_SEL_STORE:
+            tmp_selection_set(sc, tmp_sc);
+            return 0;
+        case OP_SEL_LOAD:
+            tmp_selection_use(sc, tmp_sc);
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/* Check, if program touches only the row it works on, so it can be executed one row 
+ * at a time. All rows have the same width, which is followed through the program
+ * @param width: width of rows after loading
+ * @param final: width of rows after the program
+ * @return: 0 if program is row-local
+ */
+int stream_check(Program *prog, int width, int *final){
+    Selection sc = {1,1,1,1}, tmp_sc = {1,1,1,1};
+    for (int k = 0; k < prog->size; k++){
+        Instr *ins = &prog->code[k];
+        int n = sc.end_col - sc.start_col + 1;
+        switch (ins->op){
+            case OP_SELECT: case OP_SELECT_NONE: case OP_SEL_STORE: case OP_SEL_LOAD:
+                if (stream_select(ins, &sc, &tmp_sc, width)){
+                    return 1;
+                }
+                if (sc.end_row != 0 || sc.start_col < 1 || sc.start_col > sc.end_col){
+                    return 1; //debug output of selection is not row-local either
+                }
+                if (sc.end_col > width){ //check_table_size
+                    width = sc.end_col;
+                }
+                continue;
+            case OP_ICOL: case OP_ACOL:
+                width += n;
+                break;
+            case OP_DCOL: //columns past the end are not deleted
+                if (sc.start_col <= width){
+                    width -= n < width - sc.start_col + 1 ? n : width - sc.start_col + 1;
+                }
+                break;
+            case OP_CLEAR: case OP_SET: case OP_USE: case OP_INC: case OP_NOP:
+                break;
+            default:
+                return 1;
+        }
+        if (ins->op != OP_INC && ins->op != OP_NOP && sc.end_row != 0){ //row 1 only
+            return 1;
+        }
+    }
+    *final = width;
     return 0;
 }
 
-/* After special char is found in string, set values of selection to parameter values
- * @param par, par2: parameters to set
+/* Execute first st->upto instructions on one row, the program was checked by stream_check
+ * @param i: index of the row in table
+ * @param sc: selection after the last executed instruction
+ */
+void stream_apply(Stream *st, Table *table, int i, Selection *sc){
+    Row *row = &table->rows[i];
+    Selection tmp_sc = {1,1,1,1};
+    Temporary tmp_vars;
+    variables_init(&tmp_vars);
+
+    *sc = (Selection){1,1,1,1};
+    for (int k = 0; k < st->upto; k++){
+        Instr *ins = &st->prog->code[k];
+        Selection row_sc = {i+1, i+1, sc->start_col, sc->end_col};
+        switch (ins->op){
+            case OP_SELECT: case OP_SELECT_NONE: case OP_SEL_STORE: case OP_SEL_LOAD:
+                stream_select(ins, sc, &tmp_sc, row->size);
+                while (row->size < sc->end_col){ //check_table_size
+                    row_append(&table->arena, row);
+                }
+                break;
+            case OP_ICOL: case OP_ACOL: case OP_DCOL:
+                edit_row(&table->arena, row, ins->op, &row_sc);
+                table_changed(table, -1, -1);
+                break;
+            case OP_CLEAR:
+                edit_tstruc(&row_sc, ins->op, table, st->delims);
+                break;
+            case OP_SET:
+                edit_tdata(&row_sc, table, ins, st->prog, st->delims);
+                break;
+            case OP_USE: case OP_INC:
+                edit_variables(&row_sc, table, &tmp_vars, ins, st->delims);
+                break;
+            default:
+                break;
+        }
+    }
+    sc->start_row = sc->end_row = i+1;
+    variables_destroy(&tmp_vars);
+}
+
+/* Process one complete row according to the pass */
+void stream_row(Stream *st, Table *table, int i){
+    Row *row = &table->rows[i];
+    if (st->mode == STREAM_SCAN){
+        st->rows++;
+        if (row->size > st->width){
+            st->width = row->size;
+        }
+        return;
+    }
+
+    //fill_table
+    while (row->size < st->width){
+        row_append(&table->arena, row);
+    }
+    Selection sc;
+    stream_apply(st, table, i, &sc);
+    char *delims = st->delims;
+
+    if (st->mode == STREAM_SELECTION){
+        print_selection(&sc, table, st->out);
+    }
+    else if (st->mode == STREAM_EMPTY){
+        for (int j = 0; j < row->size; j++){
+            st->filled[j] |= !cell_empty(&row->cells[j]);
+        }
+    }
+    else {
+        Row printed = *row;
+        printed.size = st->printed;
+        row_print(&printed, DELIM, st->writer);
+        writer_char(st->writer, '\n');
+    }
+}
+
+/* Drop processed rows, only the row being loaded is kept
+ * It is copied to a new arena, so memory does not grow with the size of input
+ * @param ld: loader, which continues with the kept row
+ */
+void stream_trim(Table *table, Loader *ld){
+    Table fresh;
+    table_init(&fresh);
+    table_append(&fresh);
+    Row *old = &table->rows[ld->current_row], *row = &fresh.rows[0];
+    for (int j = 0; j < old->size; j++){
+        row_append(&fresh.arena, row);
+        if (old->cells[j].size){
+            cell_append_n(&fresh.arena, &row->cells[j], old->cells[j].text, old->cells[j].size);
+        }
+        row->cells[j].delim = old->cells[j].delim;
+    }
+    table_destroy(table);
+    *table = fresh;
+    ld->current_row = 0;
+}
+
+/* Read whole file one block at a time and pass every complete row to stream_row
+ * The last row is dropped the same way as in create_table
+ * @return: 0 if successful, 1 if file could not be read
+ */
+int stream_pass(Stream *st, FILE *source){
+    if (fseek(source, 0, SEEK_SET)){
+        return 1;
+    }
+    Table table;
+    table_init(&table);
+    Loader ld;
+    loader_init(&ld, &table, st->delims);
+
+    char *block = malloc(LOAD_BLOCK);
+    if (block == NULL){
+        return 1;
+    }
+    size_t len;
+    while ((len = fread(block, 1, LOAD_BLOCK, source)) > 0){
+        loader_feed(&ld, block, len);
+        for (int i = 0; i < ld.current_row; i++){
+            stream_row(st, &table, i);
+        }
+        if (table.size){
+            stream_trim(&table, &ld);
+        }
+    }
+    free(block);
+    table_destroy(&table);
+    return ferror(source);
+}
+
+/* Execute row-local program with memory independent of the size of file
+ * The file is read several times: to find width of the table, once for debug output 
+ * of every selection, to find empty columns and to print the result
+ * @param path: path of input file, @see output_open
+ * @param source: input file, it has to be seekable
+ * @return: FILE_OK, FILE_OPEN_ERROR if file could not be read again, FILE_WRITE_ERROR,
+ *          FILE_NOT_STREAMED if program is not row-local or file is not seekable 
+ *          (nothing is printed)
+ */
+int stream_file(const Options *opts, Program *prog, const char *path, FILE *source, FILE *out){
+    Stream st = {prog, opts->delims, out, STREAM_SCAN, 0, 0, 0, 0, NULL, NULL};
+    int final;
+    if (fseek(source, 0, SEEK_SET)){
+        return FILE_NOT_STREAMED;
+    }
+    if (stream_pass(&st, source)){
+        return FILE_OPEN_ERROR;
+    }
+    if (st.rows == 0 || stream_check(prog, st.width, &final)){
+        fseek(source, 0, SEEK_SET); //file is loaded from the beginning
+        return FILE_NOT_STREAMED;
+    }
+
+    st.mode = STREAM_SELECTION;
+    for (st.upto = 1; st.upto <= prog->size; st.upto++){
+        Opcode op = prog->code[st.upto-1].op;
+        if (op == OP_SELECT || op == OP_SELECT_NONE || op == OP_SEL_STORE || op == OP_SEL_LOAD){
+            fprintf(out, "Selection:\n");
+            if (stream_pass(&st, source)){
+                return FILE_OPEN_ERROR;
+            }
+            fputc('\n', out); fputc('\n', out);
+        }
+    }
+
+    //excess_columns deletes empty columns at the end of the table
+    st.mode = STREAM_EMPTY;
+    st.upto = prog->size;
+    st.filled = calloc(final ? final : 1, sizeof(bool));
+    if (st.filled == NULL || stream_pass(&st, source)){
+        free(st.filled);
+        return FILE_OPEN_ERROR;
+    }
+    st.printed = final;
+    while (st.printed > 0 && !st.filled[st.printed-1]){
+        st.printed--;
+    }
+    free(st.filled);
+
+    st.mode = STREAM_PRINT;
+    Writer w;
+    char tmp[strlen(path)+8];
+    if (output_open(opts, path, out, &w, tmp)){
+        return FILE_WRITE_ERROR;
+    }
+    st.writer = &w;
+    int read_error = stream_pass(&st, source);
+    if (output_close(opts, path, &w, tmp)){
+        return FILE_WRITE_ERROR;
+    }
+    return read_error ? FILE_OPEN_ERROR : FILE_OK;
+}
+
+  /*****************************/
+ /*******BATCH FUNCTIONS*******/
+/*****************************/
+
+/* Load file, execute program on its table and print the result
+ * @param opts: program options
+ * @param prog: compiled command sequence, it is only read
+ * @param path: input file
+ * @param out: destination of debug output, error messages and the table (without -i)
+ * @return: FILE_OK, FILE_OPEN_ERROR, FILE_WRITE_ERROR or FILE_CMD_ERROR (table is not printed)
  */
-void set_params(Selection *sc, Table *table, int par, int par2){
-    if (par == 0){  
-        sc->end_row = table->size;
-    } else {
-        sc->end_row = par;
+int process_file(const Options *opts, Program *prog, const char *path, FILE *out){
+    char *delims = opts->delims;
+    Table table;
+    table_init(&table);
+    
+    if (opts->in_place && journal_recover(path)){ //previous patch was interrupted
+        return FILE_OPEN_ERROR;
     }
 
-    if (par2 == 0){
-        sc->end_col = table->rows[0].size;
-    } else {
-        sc->end_col = par2;
+    FILE *file;
+    file = fopen(path, "r");
+    if (file == NULL){
+        return FILE_OPEN_ERROR;
     }
-}
 
-/* Function for exctacting parameters from selection in format [int,int]
- * @param arg: argument in format [int,int]
- */ 
-int simple_selection(Selection *sc, char *arg, Table *table){
-    int par1 = -1, par2 = -1, count; 
-    count = sscanf(arg, "[%d,%d]", &par1, &par2);
+    Profile prof;
+    profile_init(&prof);
+    if (opts->profile != NULL){
+        table.profile = &prof;
+        profile_begin(&prof, &table);
+    }
+    int snapshot = create_table_snapshot(&table, file);
+    if (snapshot == 2){
+        fprintf(stderr, "%s: nedostatok pamate na nacitanie snapshotu\n", path);
+        fclose(file);
+        return FILE_OPEN_ERROR;
+    }
 
-    //setting end values
-    if (count != 2){
-        if (special_chars(arg, 0, SELECTION_DELIM, '_')) { //looking for [_,]
-            return 1;
-        } 
-        
-        if (special_chars(arg, 1, ']', '_')) { //looking for [,_]
-            return 1;
+    if (opts->stream && snapshot){
+        int status = stream_file(opts, prog, path, file, out);
+        if (status != FILE_NOT_STREAMED){
+            fclose(file);
+            return status;
         }
+        fprintf(stderr, "%s: prikazy nepracuju len s jednym riadkom, subor sa spracuje v pamati\n",
+                path);
+    }
 
-        sscanf(arg, "[%d,%d]", &par1, &par2);
-        set_params(sc, table, par1, par2);
-        
-    } else {
-        if (par1 > 0 && par2 > 0){
-            sc->end_row = par1;
-            sc->end_col = par2;
-        } else return 1;
+    bool loaded = !snapshot || (opts->lazy && !create_table_lazy(&table, file, delims)) ||
+                  (opts->threads > 1 && 
+                  !create_table_parallel(&table, file, delims, opts->threads, opts->mmap));
+    if (!loaded && (!opts->mmap || create_table_mmap(&table, file, delims))){
+        create_table(&table, file, delims);    
     }
-    
-    //setting start values
-    if (par1 == 0){ // [_,num]
-        sc->start_row = par1+1; 
-    } else {
-        sc->start_row = par1; 
+    fill_table(&table);
+    table.columns.enabled = opts->columnar;
+    table.index.enabled = opts->find_index;
+    table.threads = opts->threads;
+    if (table.profile != NULL){
+        profile_end(&prof, &table, "load", table_cells(&table));
     }
 
-    if (par2 == 0){ //[num,_]
-        sc->start_col = par2+1;
-    } else {
-        sc->start_col = par2;
-    }
+    Selection sc = {1,1,1,1}; //default selection is first row,column
+    Selection tmp_sc = {1,1,1,1};
+    Temporary tmp_vars;
 
-    return 0;
-}
+    variables_init(&tmp_vars);
 
-/*Similiar to simple_selection but uses 4 numbers*/
-int advanced_selection(Selection *sc, char *arg, Table *table){
-    int par1 = -1, par2 = -1, par3 = -1, par4 = -1, count; 
-    count = sscanf(arg, "[%d,%d,%d,%d]", &par1, &par2, &par3, &par4);
+    if (run_program(prog, &sc, &tmp_sc, &table, &tmp_vars, delims, out)){
+        profile_destroy(&prof);
+        table_destroy(&table);
+        variables_destroy(&tmp_vars);
+        fclose(file);
+        return FILE_CMD_ERROR;
+    }
 
-    if (par1 <= 0 || par2 <= 0){
-        return 1;
-    }    
-    
-    if (count != 4){
-        if (special_chars(arg, 2, SELECTION_DELIM, '-')) { // [num,num,-,num]
-            return 1;
-        } 
-        if (special_chars(arg, 3, ']', '-')) { // [num,num,num,-]
-            return 1;
-        }
-        sscanf(arg, "[%d,%d,%d,%d]", &par1, &par2, &par3, &par4);
-        set_params(sc, table, par3, par4);
+    if (table.profile != NULL){
+        profile_begin(&prof, &table);
+    }
+    fill_table(&table); 
+    excess_columns(&table);
 
+    Writer w;
+    char tmp[strlen(path)+8];
+    int status = FILE_OK;
+    if (opts->snapshot != NULL){
+        status = snapshot_write(&table, opts->snapshot) ? FILE_WRITE_ERROR : FILE_OK;
+    }
+    else if (output_open(opts, path, out, &w, tmp)){
+        status = FILE_WRITE_ERROR;
     } else {
-        if (par3 > 0 && par4 > 0 && par1 <= par3 && par2 <= par4){
-            sc->start_row = par1;
-            sc->start_col = par2;
-            sc->end_row = par3;
-            sc->end_col = par4;
-        } else return 1;
+        table_print(&table, DELIM, &w);
+        w.error = w.error || table.damaged; //input is not replaced by damaged output
+        if (output_close(opts, path, &w, tmp)){
+            status = FILE_WRITE_ERROR;
+        }
+    }
+    if (table.damaged){
+        fprintf(stderr, "%s: snapshot tabulky je poskodeny\n", path);
+        status = FILE_OPEN_ERROR;
+    }
+    if (table.profile != NULL){
+        profile_end(&prof, &table, "print", table_cells(&table));
+        if (profile_report(&prof, path, opts->profile)){
+            fprintf(stderr, "Nepodarilo sa zapisat profil\n");
+        }
     }
+    profile_destroy(&prof);
     
-    if (par3 == 0 || par4 == 0){
-        sc->start_row = par1; 
-        sc->start_col = par2;
+    if (opts->stats){
+        arena_print_stats(&table.arena, stderr);
     }
-
-    return 0;
+    table_destroy(&table);
+    variables_destroy(&tmp_vars);
+    fclose(file);
+    return status;
 }
 
-/* Function to determine, what type of selection was found
- * @param sc: selection struct
- * @param arg: command from user
- * @param table: table struct
- * return: 1 if any error has occured, 0 if everything was successful
- */
-int set_selection(Selection *sc, Selection *tmp_sc, char *arg, Table *table){
-    int counter = char_in_string(SELECTION_DELIM, arg); //number of commas 
+//Queue of files shared by batch workers
+typedef struct {
+    const Options *opts;
+    Program *prog;
+    char **files;
+    int size;
+    int next; //index of next file to process
+    int failed;
+    bool *clash; //output of the file has the same name as output of another file (-o)
+    pthread_mutex_t lock; //guards next, failed and writing to stdout/stderr
+} Batch;
 
-    int error;
-    if (counter == 0){
-        error = specify_selection(sc, tmp_sc, arg, table); //[max]
-    } else if (counter == 1){
-        error = simple_selection(sc, arg, table); //[int,int]
-    } else if (counter == 3){
-        error = advanced_selection(sc, arg, table); //[int,int,int,int]
-    } else {
-        error = 1;
-    }
+//Name of output of a file in batch mode (-o)
+typedef struct {
+    const char *name;
+    int file; //index of the file in batch
+} BatchName;
 
-    if (error){
-        return 1;
+/* Monotonic time in seconds */
+double batch_clock(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Text describing result of processing one file */
+const char * batch_status(int status){
+    switch (status){
+        case FILE_OK: return "OK";
+        case FILE_OPEN_ERROR: return "chyba pri otvarani suboru";
+        case FILE_CMD_ERROR: return "chybne zadane prikazy";
+        case FILE_OUT_CLASH: return "vystup by prepisal vstup alebo vystup ineho suboru";
+        default: return "chyba pri zapise vystupu";
     }
-    check_table_size(sc, table);
-    
-    /*debug mode*/
-    printf("Selection:\n");
-    print_selection(sc, table);
-    putchar('\n'); putchar('\n');
+}
 
-    return 0;
+/* Name of input file without its directories */
+const char * batch_name(const char *path){
+    const char *name = strrchr(path, '/');
+    return name == NULL ? path : name+1;
 }
 
-/* Functions for editing structure of the whole table */
-int edit_tstruc(Selection *sc, char *arg, Table *table, char *delims){
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            if (!strcmp(arg, "irow")){
-                table_insert(table, i);
-            }
-            else if (!strcmp(arg, "arow")){
-                table_insert(table, i+1);
-            }
-            else if (!strcmp(arg, "icol")){
-                row_insert(&table->rows[i], j);
-            }
-            else if (!strcmp(arg, "acol")){
-                row_insert(&table->rows[i], j+1);
-            }
-            else if (!strcmp(arg, "dcol")){
-                cell_delete(&table->rows[i], j);
-            }
-            else if (!strcmp(arg, "clear")){
-                cell_rewrite(&table->rows[i].cells[j], "\0", delims);
-            }
-        }
-        if (!strcmp(arg, "drow")){ 
-            row_delete(table, i);
-        }
-    }
-    return 0;
+/* Path of output of one file in DIR (-o)
+ * @param out_path: buffer for the path, see batch_path_size
+ */
+void batch_path(Batch *batch, const char *path, char *out_path){
+    sprintf(out_path, "%s/%s", batch->opts->out_dir, batch_name(path));
 }
 
-/* Edits temporary variables based on user command */
-int edit_variables(Selection *sc, Table *table, Temporary *tmp_vars, char *arg, char *param,
-                   char *delims){
-    int var;
-    if (sscanf(param, "%d", &var) != 1){
-        return 1;
+/* Size of buffer for batch_path (with suffix of temporary file) */
+size_t batch_path_size(Batch *batch, const char *path){
+    return strlen(batch->opts->out_dir) + strlen(batch_name(path)) + 9;
+}
+
+/* Open output of one file - temporary file in DIR, which is renamed to DIR/name of input file
+ * by batch_commit, or buffer in memory, which is later copied to stdout as a whole
+ * @param tmp: buffer for path of temporary file (see batch_path_size)
+ * @param status: set to FILE_OUT_CLASH, if the output would replace the input
+ * @return: opened file or NULL
+ */
+FILE * batch_output(Batch *batch, const char *path, char **buffer, size_t *size, char *tmp,
+                    int *status){
+    if (batch->opts->out_dir == NULL){
+        return open_memstream(buffer, size);
     }
-    if (var < 0 || var >= 10){
-        return 1;
+    struct stat in, out;
+    batch_path(batch, path, tmp);
+    if (!stat(path, &in) && !stat(tmp, &out) && in.st_dev == out.st_dev && in.st_ino == out.st_ino){
+        *status = FILE_OUT_CLASH;
+        return NULL;
     }
+    strcat(tmp, ".XXXXXX");
+    int fd = mkstemp(tmp);
+    if (fd >= 0){ //output gets the usual mode instead of the one of mkstemp
+        mode_t mask = umask(0);
+        umask(mask);
+        fchmod(fd, 0666 & ~mask);
+    }
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "w");
+    if (f == NULL && fd >= 0){
+        close(fd);
+        unlink(tmp);
+    }
+    return f;
+}
 
-    if (!strcmp(arg, "def")){
-        int len = table->rows[sc->end_row-1].cells[sc->end_col-1].size;
-        char text[len+1];
-        get_cell_text(&table->rows[sc->end_row-1].cells[sc->end_col-1], text);
-        cell_rewrite(&tmp_vars->variables[var], text, delims); 
-    }
-    else if (!strcmp(arg, "use")){
-        for (int row = sc->start_row-1; row < sc->end_row; row++){
-            for (int col = sc->start_col-1; col < sc->end_col; col++){
-                int len = tmp_vars->variables[var].size;
-                char text[len+1];
-                get_cell_text(&tmp_vars->variables[var], text);
-                cell_rewrite(&table->rows[row].cells[col], text, delims);
-            }
-        }
-    } 
-    else if (!strcmp(arg, "inc")){
-        double num;
-        char text[50];
-        if (tmp_vars->variables[var].text != NULL){
-            if (sscanf(tmp_vars->variables[var].text, "%lf", &num)){
-                num++;
-                sprintf(text, "%g", num);
-            } else {
-                num = 1.0;
-                sprintf(text, "%g", num);
-            }
-        } else {
-            num = 1.0;
-            sprintf(text, "%g", num);
-        }
-
-        cell_rewrite(&tmp_vars->variables[var], text, delims);
+/* Replace output of one file in DIR (-o) by its temporary file, or remove the temporary file
+ * if the file failed, so an old output is kept
+ * @param tmp: path of temporary file from batch_output
+ * @return: status of the file, FILE_WRITE_ERROR if it could not be renamed
+ */
+int batch_commit(Batch *batch, const char *path, const char *tmp, int status){
+    char out_path[batch_path_size(batch, path)];
+    batch_path(batch, path, out_path);
+    if (status == FILE_OK && rename(tmp, out_path)){
+        status = FILE_WRITE_ERROR;
     }
+    if (status != FILE_OK){
+        unlink(tmp);
+    }
+    return status;
+}
 
-    return 0;
+/* Compare outputs of files by their names (qsort) */
+int batch_name_compare(const void *a, const void *b){
+    return strcmp(((const BatchName *)a)->name, ((const BatchName *)b)->name);
 }
 
-/* Extract values from string in format [int,int] to integers par1, par2
- * @param arg: string in format [int,int]
- * @param par1,par2: integers to store output values to
+/* Mark files, which outputs in DIR (-o) have the same name, none of them is written
+ * @return: 0 if successful, 1 if memory could not be allocated
  */
-int args_to_int(Table *table, char *arg, int *par1, int *par2){
-    if (sscanf(arg, "[%d,%d]", par1, par2) != 2){
+int batch_clashes(Batch *batch){
+    int n = batch->size ? batch->size : 1;
+    batch->clash = calloc(n, sizeof(bool));
+    BatchName *names = malloc(n * sizeof(BatchName));
+    if (batch->clash == NULL || names == NULL){
+        free(names);
         return 1;
     }
-    if (*par1 <= 0 || *par2 <= 0 || *par1 > table->size || *par2 > table->rows[0].size ){
-        return 1;
+    for (int k = 0; k < batch->size; k++){
+        names[k] = (BatchName){batch_name(batch->files[k]), k};
+    }
+    qsort(names, batch->size, sizeof(BatchName), batch_name_compare);
+    for (int k = 1; k < batch->size; k++){
+        if (!strcmp(names[k-1].name, names[k].name)){
+            batch->clash[names[k-1].file] = batch->clash[names[k].file] = true;
+        }
     }
+    free(names);
     return 0;
 }
 
-/* Functions for editing data in table 
- * @param arg: first part of user command (before space character)
- * @param param: second part of user command (parameters)
+/* Worker of batch mode, takes files from queue until it is empty
+ * Every file gets its own table, selections and temporary variables
+ * @param arg: batch struct
  */
-int edit_tdata(Selection *sc, Table *table, char *arg, char *param, char *delims){
-    int par1, par2, counter = 0;
-    double temp_value = 0, num = 0;
-    char sum[50];
+void * batch_worker(void *arg){
+    Batch *batch = arg;
+    while (true){
+        pthread_mutex_lock(&batch->lock);
+        int k = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (k >= batch->size){
+            break;
+        }
 
-    for (int i = sc->start_row-1; i < sc->end_row; i++){
-        for (int j = sc->start_col-1; j < sc->end_col; j++){
-            if (!strcmp(arg, "set")){
-                cell_rewrite(&table->rows[i].cells[j], param, delims);
-            }
-            else if (!strcmp(arg, "swap")){
-                if (args_to_int(table, param, &par1, &par2)){
-                    return 1;
-                }
-                cell_swap(table, i, j, par1-1, par2-1);
-            }
-            else if (!strcmp(arg, "sum")){
-                if (args_to_int(table, param, &par1, &par2)){
-                    return 1;
-                }
-                num = 0;
-                if (!string_to_double(CELL_TEXT, &num)){
-                    temp_value += num;
-                }
+        const char *path = batch->files[k];
+        char *buffer = NULL;
+        size_t size = 0;
+        double start = batch_clock();
+        char tmp[batch->opts->out_dir ? batch_path_size(batch, path) : 1];
+        int status = batch->clash != NULL && batch->clash[k] ? FILE_OUT_CLASH : FILE_WRITE_ERROR;
+        FILE *out = status == FILE_OUT_CLASH ? NULL : 
+                    batch_output(batch, path, &buffer, &size, tmp, &status);
+        if (out != NULL){
+            status = process_file(batch->opts, batch->prog, path, out);
+            if (fclose(out) && status == FILE_OK){
+                status = FILE_WRITE_ERROR;
             }
-            else if (!strcmp(arg, "avg")){
-                if (args_to_int(table, param, &par1, &par2)){
-                    return 1;
-                }
-                num = 0;
-                if (!string_to_double(CELL_TEXT, &num)){
-                    temp_value += num;
-                    counter++;
-                }
-                if (i+1 == sc->end_row && j+1 == sc->end_col){
-                    temp_value /= counter;
-                }
-            }
-            else if (!strcmp(arg, "count")){
-                if (args_to_int(table, param, &par1, &par2)){
-                    return 1;
-                }
-                num = 0;
-                if (CELL_TEXT != NULL && strcmp(CELL_TEXT, "")){
-                    counter++;
-                }
-                if (i+1 == sc->end_row && j+1 == sc->end_col){
-                    temp_value = counter;    
-                }
-            }
-            else if (!strcmp(arg, "len")){
-                if (args_to_int(table, param, &par1, &par2)){
-                    return 1;
-                }
-                num = 0;
-                if (CELL_TEXT != NULL && strcmp(CELL_TEXT, "")){
-                    temp_value = table->rows[i].cells[j].size;
-                } else {
-                    temp_value = 0;
-                }
+            if (batch->opts->out_dir != NULL){
+                status = batch_commit(batch, path, tmp, status);
             }
+        }
+        double elapsed = batch_clock() - start;
 
+        pthread_mutex_lock(&batch->lock);
+        if (buffer != NULL && size > 0){ //file, which could not be opened, has no section
+            printf("==> %s <==\n", path);
+            fwrite(buffer, 1, size, stdout);
         }
+        fprintf(stderr, "%s: %s (%.3f ms)\n", path, batch_status(status), elapsed * 1e3);
+        batch->failed += status != FILE_OK;
+        pthread_mutex_unlock(&batch->lock);
+        free(buffer);
     }
+    return NULL;
+}
 
-    if (!strcmp(arg, "sum") || !strcmp(arg, "avg") ||
-        !strcmp(arg, "count") || !strcmp(arg, "len")){
-        sprintf(sum, "%g", temp_value);
-        cell_rewrite(&table->rows[par1-1].cells[par2-1], sum, delims);
+/* Read list of files from stdin, one path per line
+ * @param files: pointer to array of paths to fill
+ * @return: number of paths or -1 if memory could not be allocated
+ */
+int read_manifest(char ***files){
+    int size = 0, cap = 0;
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t read;
+    *files = NULL;
+    while ((read = getline(&line, &len, stdin)) != -1){
+        if (read > 0 && line[read-1] == '\n'){
+            line[--read] = '\0';
+        }
+        if (read == 0){
+            continue;
+        }
+        if (size == cap){
+            cap = cap ? cap*2 : 16;
+            char **resized = realloc(*files, cap * sizeof(char *));
+            if (resized == NULL){
+                break;
+            }
+            *files = resized;
+        }
+        if (((*files)[size] = strdup(line)) == NULL){
+            break;
+        }
+        size++;
     }
-
-    return 0;
+    free(line);
+    if (!feof(stdin)){
+        for (int i = 0; i < size; i++){
+            free((*files)[i]);
+        }
+        free(*files);
+        return -1;
+    }
+    return size;
 }
 
-/* Seperate string into 2 parts by given delimiter, format and return first or second part
- * @param curr_cmnd: command from user to process
- * @param delim: delimiter of substrings
- * @param format: format, in which whey will be split
- * @param n: return first or second part
+/* Process many files with one program on a pool of worker threads
+ * Failure of one file does not stop the batch, result and time of every file is 
+ * reported to stderr
+ * @param opts: options with list of files (files are read from stdin if the list is empty)
+ * @return: 0 if all files were processed, 1 otherwise
  */
-char * string_separate(char *curr_cmnd, char delim, char *format, int n){
-    int len = char_index(delim, curr_cmnd, 1);
-    char *arg = malloc(len+1);
-    char *param = malloc(strlen(curr_cmnd)-len);
-    if (arg == NULL || param == NULL){
-        return NULL;
+int run_batch(const Options *opts, Program *prog){
+    Batch batch = {opts, prog, opts->files, opts->nfiles, 0, 0, NULL, PTHREAD_MUTEX_INITIALIZER};
+    bool manifest = batch.size == 0;
+    if (manifest && (batch.size = read_manifest(&batch.files)) < 0){
+        fprintf(stderr, "Nedostatok pamate\n");
+        return 1;
     }
-
-    if (sscanf(curr_cmnd, format, arg, param) != 2){
-        free(arg); free(param);
-        return NULL;
+    if (opts->out_dir != NULL && batch_clashes(&batch)){
+        fprintf(stderr, "Nedostatok pamate\n");
+        batch.failed = batch.size;
+        batch.next = batch.size; //no file is processed
     }
 
-    if (n == 1){
-        free(param);
-        return arg;
-    } else {
-        free(arg);
-        return param;
+    int jobs = opts->jobs ? opts->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > batch.size){
+        jobs = batch.size;
+    }
+    if (jobs < 1){
+        jobs = 1;
     }
-}
 
-/* Process commands - separate them, indentify, call appropriate function */
-int parse_commands(char **argv, Selection *sc, Selection *tmp_sc, Table *table, 
-                   Temporary *tmp_vars, char *delims){
-    int pos;
-    if (!strcmp("-d", argv[1])){
-        pos = 3;
-    } else {
-        pos = 1;
+    double start = batch_clock();
+    pthread_t workers[jobs];
+    int started = 0;
+    while (started < jobs && !pthread_create(&workers[started], NULL, batch_worker, &batch)){
+        started++;
     }
-    
-    char *cmd_seq = argv[pos];
-    char *curr_cmnd = strtok(cmd_seq, CMD_DELIM);
-    while (curr_cmnd != NULL){
-        if (curr_cmnd[0] == '['){
-            if (set_selection(sc, tmp_sc, curr_cmnd, table)){
-                printf("Chybne argumenty selekcie\n");
-                return 1;
-            }
-        } 
-        else if (!char_in_string(' ', curr_cmnd)){
-            edit_tstruc(sc, curr_cmnd, table, delims);
-        }
-        else if(char_in_string('_', curr_cmnd)){
-            char *arg, *param;
-            arg = string_separate(curr_cmnd, ' ', "%s _%s", 1);
-            param = string_separate(curr_cmnd, ' ', "%s _%s", 2);
-            if (arg == NULL || param == NULL){ //no parameter or arg was found
-                printf("Chybne zadane prikazy\n");
-                free(arg); free(param);
-                return 1;
-            }
-            if (edit_variables(sc, table, tmp_vars, arg, param, delims)){ //parameter was not valid
-                printf("Chybne zadane prikazy\n");
-                free(arg); free(param);
-                return 1;
-            }
-            free(arg); free(param);
-        }
-        else {
-            char *arg, *param;
-            arg = string_separate(curr_cmnd, ' ', "%s %s", 1);
-            param = string_separate(curr_cmnd, ' ', "%s %s", 2);
-            if (arg == NULL || param == NULL){ //no parameter or arg was found
-                printf("Chybne zadane prikazy\n");
-                free(arg); free(param);
-                return 1;
-            }
-            if (edit_tdata(sc, table, arg, param, delims)){ //parameter was not valid
-                printf("Chybne zadane prikazy\n");
-                free(arg); free(param);
-                return 1;
-                }
-            free(arg); free(param);
-        }
-        curr_cmnd = strtok(NULL, CMD_DELIM);
+    if (started == 0){ //no thread could be created
+        batch_worker(&batch);
     }
-    return 0;
-}
+    for (int i = 0; i < started; i++){
+        pthread_join(workers[i], NULL);
+    }
+    fprintf(stderr, "spracovanych suborov: %d, chyb: %d, cas: %.3f s\n", 
+            batch.size, batch.failed, batch_clock() - start);
 
-/* Remove excess (most right empty) colums from table */
-void excess_columns(Table *table){
-    int empty_rows;
-    for (int j = table->rows[0].size-1; j >= 0; j--){
-        empty_rows = 0;
-        for (int i = 0; i < table->size; i++){
-            if (!table->rows[i].cells[j].size || !*table->rows[i].cells[j].text){
-                empty_rows++;
-            }
-        }
-        if (empty_rows == table->size){
-            for (int i = 0; i < table->size; i++){
-                cell_delete(&table->rows[i], table->rows[i].size-1);
-            }
+    if (manifest){
+        for (int i = 0; i < batch.size; i++){
+            free(batch.files[i]);
         }
+        free(batch.files);
     }
+    free(batch.clash);
+    pthread_mutex_destroy(&batch.lock);
+    return batch.failed != 0;
 }
 
 int main(int argc, char **argv){
@@ -1125,51 +6093,30 @@ int main(int argc, char **argv){
     }
    
     Args args = {argv, argc};
-    char *delims = find_delim(args);
-    Table table;
-    table_init(&table);
-    
-    FILE *file;
-    file = fopen(argv[argc-1], "r");
-    if (file == NULL){
-        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+    Options opts;
+    if (parse_options(args, &opts)){
+        fprintf(stderr, "Chybne zadane argumenty\n");
         return 1;
     }
 
-    create_table(&table, file, delims);    
-    fill_table(&table);
-    
-    //fclose(file); //comment for debug mode
-
-    Selection sc = {1,1,1,1}; //default selection is first row,column
-    Selection tmp_sc = {1,1,1,1};
-    Temporary tmp_vars;
-
-    variables_init(&tmp_vars);
-
-    if (parse_commands(argv, &sc, &tmp_sc, &table, &tmp_vars, delims)){
-        table_destroy(&table);
-        variables_destroy(&tmp_vars);
+    Program prog;
+    if (compile_program(&prog, opts.cmd_seq, opts.program)){
+        fprintf(stderr, "Nedostatok pamate\n");
         return 1;
     }
 
-    /*
-    file = fopen(argv[argc-1], "w");                                  //          //
-    if (file == NULL){                                                // comment  //
-        fprintf(stderr, "Nastala chyba pri otvarani suboru\n");       //   for    //
-        return 1;                                                     //  debug   //
-    } */                                                                //          //
-    
-    fill_table(&table); 
-    excess_columns(&table);
-
-    //table_print(&table, DELIM, file);                                // comment for debug
-    table_print(&table, DELIM, stdout);                            //uncomment for debug
-    
-    table_destroy(&table);
-    variables_destroy(&tmp_vars);
-    fclose(file);
-    return 0;
+    int status;
+    if (opts.batch){
+        status = run_batch(&opts, &prog);
+    } else {
+        status = process_file(&opts, &prog, opts.file, stdout);
+        if (status == FILE_OPEN_ERROR){
+            fprintf(stderr, "Nastala chyba pri otvarani suboru\n");
+        }
+        else if (status == FILE_WRITE_ERROR){
+            fprintf(stderr, "Nastala chyba pri zapise vystupu\n");
+        }
+    }
+    program_destroy(&prog);
+    return status != FILE_OK;
 }
-
-